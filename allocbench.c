@@ -0,0 +1,70 @@
+// Page allocator scaling benchmark.
+// For 1..NCPU concurrent workers, each worker repeatedly grows
+// its heap by CHUNK pages, touches every page so that the kernel
+// allocates it, and shrinks the heap again, freeing the pages.
+// Reports the pages allocated and freed per second across all
+// workers.  With per-CPU page caches the rate should grow with
+// the number of workers up to the number of CPUs; with a single
+// allocator lock it flattens out.
+//
+// usage: allocbench [maxworkers]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define CHUNK  16     // pages per round
+#define ROUNDS 2000   // rounds per worker
+#define PGSIZE 4096
+
+void
+worker(void)
+{
+  char *p, *q;
+  int r;
+
+  for(r = 0; r < ROUNDS; r++){
+    if((p = sbrk(CHUNK * PGSIZE)) == (char*)-1){
+      printf(2, "allocbench: sbrk failed\n");
+      exit();
+    }
+    for(q = p; q < p + CHUNK * PGSIZE; q += PGSIZE)
+      *q = 1;
+    sbrk(-CHUNK * PGSIZE);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, k, maxk, pid;
+  uint start, t;
+
+  maxk = NCPU;
+  if(argc > 1)
+    maxk = atoi(argv[1]);
+
+  printf(1, "allocbench: %d rounds of %d pages per worker\n", ROUNDS, CHUNK);
+  for(k = 1; k <= maxk; k++){
+    start = uptime();
+    for(i = 0; i < k; i++){
+      pid = fork();
+      if(pid < 0){
+        printf(2, "allocbench: fork failed\n");
+        exit();
+      }
+      if(pid == 0){
+        worker();
+        exit();
+      }
+    }
+    for(i = 0; i < k; i++)
+      wait();
+    t = uptime() - start;
+    if(t == 0)
+      t = 1;
+    printf(1, "%d workers: %d pages/sec\n", k, k * ROUNDS * CHUNK * HZ / t);
+  }
+  exit();
+}
@@ -0,0 +1,41 @@
+// Report how fragmented free physical memory is.
+// For each block size the buddy allocator keeps, print the
+// number of free blocks, and the share of free memory that
+// sits in smaller blocks and so cannot satisfy an allocation
+// of that size.
+//
+// usage: buddyinfo
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+uint nblock[MAXORDER+1];
+
+int
+main(void)
+{
+  int o, n;
+  uint total, below, pages;
+
+  if((n = buddyinfo(nblock)) != MAXORDER+1){
+    printf(2, "buddyinfo: failed\n");
+    exit();
+  }
+  total = 0;
+  for(o = 0; o < n; o++)
+    total += nblock[o] << o;
+
+  printf(1, "order   size  blocks   pages  unusable\n");
+  below = 0;
+  for(o = 0; o < n; o++){
+    pages = nblock[o] << o;
+    printf(1, "%d\t%dK\t%d\t%d\t%d%%\n", o, 4 << o, nblock[o], pages,
+           total ? below * 100 / total : 0);
+    below += pages;
+  }
+  printf(1, "%d pages free in blocks, %d more in per-CPU caches\n",
+         total, freemem() - total);
+  exit();
+}
@@ -0,0 +1,83 @@
+// Context switch benchmark.
+// Two processes pass a byte back and forth over a pair of pipes,
+// so that every hop blocks one and wakes the other, and report
+// the time per switch.  Each side also touches NPAGE pages of
+// its own memory per hop, as a program with a working set does,
+// so that TLB refills after each %cr3 load show up in the cost.
+// Run with CPUS=1 so that both sides share one CPU.
+//
+// usage: ctxbench [npage]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define RUNTIME 100    // ticks to spend timing
+#define PGSIZE  4096
+
+int npage;
+char *mem;
+
+void
+touch(void)
+{
+  int i;
+
+  for(i = 0; i < npage; i++)
+    mem[i * PGSIZE]++;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ping[2], pong[2], n, pid;
+  uint start, t;
+  char c;
+
+  npage = 0;
+  if(argc > 1)
+    npage = atoi(argv[1]);
+  if(npage > 0 && (mem = sbrk(npage * PGSIZE)) == (char*)-1){
+    printf(2, "ctxbench: sbrk failed\n");
+    exit();
+  }
+  touch();
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf(2, "ctxbench: pipe failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(2, "ctxbench: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    close(ping[1]);
+    close(pong[0]);
+    while(read(ping[0], &c, 1) == 1){
+      touch();
+      write(pong[1], &c, 1);
+    }
+    exit();
+  }
+  close(ping[0]);
+  close(pong[1]);
+
+  c = 0;
+  start = uptime();
+  for(n = 0; (t = uptime() - start) < RUNTIME; n++){
+    touch();
+    write(ping[1], &c, 1);
+    if(read(pong[0], &c, 1) != 1){
+      printf(2, "ctxbench: read failed\n");
+      exit();
+    }
+  }
+  close(ping[1]);
+  wait();
+  printf(1, "%d pages touched: %d ns per switch\n", npage,
+         t * (1000000000 / HZ) / (2 * n));
+  exit();
+}
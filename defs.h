@@ -2,13 +2,16 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct kcache;
 struct pipe;
 struct proc;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
+struct shm;
 struct stat;
 struct superblock;
+struct timer;
 
 // bio.c
 void            binit(void);
@@ -64,10 +67,24 @@ extern uchar    ioapicid;
 void            ioapicinit(void);
 
 // kalloc.c
+extern uint     phystop;
 char*           kalloc(void);
+char*           kallocblk(int);
+char*           kalloczero(void);
+void            kbuddyinfo(uint*);
 void            kfree(char*);
+void            kfreeblk(char*, int);
+int             kfreepages(void);
+void            kincref(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+int             krefcount(char*);
+int             kzeroidle(void);
+
+// kcache.c
+void*           kcachealloc(struct kcache*);
+struct kcache*  kcachecreate(char*, uint);
+void            kcachefree(struct kcache*, void*);
 
 // kbd.c
 void            kbdintr(void);
@@ -78,6 +95,9 @@ int             lapicid(void);
 extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
+void            lapicipi(uchar, int);
+void            lapictimer(uint);
+extern uint     tsctick;
 void            lapicstartap(uchar, uint);
 void            microdelay(int);
 
@@ -95,14 +115,30 @@ void            mpinit(void);
 void            picenable(int);
 void            picinit(void);
 
+// mmap.c
+int             mmap(struct file*, struct shm*, uint, int, uint);
+int             munmap(uint, uint);
+uint            userend(struct proc*, uint);
+void            vmadup(struct proc*);
+void            vmafree(struct proc*);
+struct vma*     vmalookup(struct proc*, uint);
+struct vma*     vmaoverlap(struct proc*, uint, uint);
+
+// pagecache.c
+void            pcfree(struct inode*);
+char*           pcget(struct inode*, uint, uint);
+void            pcinit(void);
+
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
+void            pipeinit(void);
 int             piperead(struct pipe*, char*, int);
 int             pipewrite(struct pipe*, char*, int);
 
 //PAGEBREAK: 16
 // proc.c
+void            boost(void);
 int             cpuid(void);
 void            exit(void);
 int             fork(void);
@@ -114,13 +150,36 @@ void            pinit(void);
 void            procdump(void);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
+void            schedtick(void);
+int             setpriority(int, int);
+int             setsched(int);
+int             settickets(int);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
+struct proc*    swapnext(void);
+struct proc*    swapproc(int);
 void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
 void            yield(void);
 
+// shm.c
+int             shmat(int);
+void            shmclose(struct shm*);
+int             shmdt(uint);
+struct shm*     shmdup(struct shm*);
+int             shmget(int, uint);
+void            shminit(void);
+char*           shmpage(struct shm*, uint);
+
+// swap.c
+char*           kallocswap(int);
+void            swapdup(int);
+void            swapfree(int);
+int             swapin(pde_t*, uint);
+void            swapinit(void);
+int             swapout(void);
+
 // swtch.S
 void            swtch(struct context**, struct context*);
 
@@ -151,16 +210,23 @@ char*           strncpy(char*, const char*, int);
 // syscall.c
 int             argint(int, int*);
 int             argptr(int, char**, int);
+int             argptrw(int, char**, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
 void            syscall(void);
 
 // timer.c
-void            timerinit(void);
+void            timeradd(struct timer*, uint);
+void            timerdel(struct timer*);
+void            timerinit(struct timer*, void (*)(void*), void*);
+uint            timernext(void);
+void            timerrun(uint);
 
 // trap.c
 void            idtinit(void);
+uint            ticknextwake(void);
+void            tickupdate(void);
 extern uint     ticks;
 void            tvinit(void);
 extern struct spinlock tickslock;
@@ -171,6 +237,7 @@ void            uartintr(void);
 void            uartputc(int);
 
 // vm.c
+extern pde_t*   kpgdir;
 void            seginit(void);
 void            kvmalloc(void);
 pde_t*          setupkvm(void);
@@ -179,12 +246,15 @@ int             allocuvm(pde_t*, uint, uint);
 int             deallocuvm(pde_t*, uint, uint);
 void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
-int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
-pde_t*          copyuvm(pde_t*, uint);
+pde_t*          copyuvm(struct proc*);
+int             cowfault(pde_t*, uint);
+int             uvmfault(struct proc*, uint, int);
+int             uvmprefault(struct proc*, uint, uint, int);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
+pde_t*          walkpgdir(pde_t*, const void*, int);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
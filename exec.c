@@ -2,6 +2,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
 #include "x86.h"
@@ -11,11 +12,12 @@ int
 exec(char *path, char **argv)
 {
   char *s, *last;
-  int i, off;
+  int i, off, nseg;
   uint argc, sz, sp, ustack[3+MAXARG+1];
   struct elfhdr elf;
-  struct inode *ip;
+  struct inode *ip, *exe, *oldexe;
   struct proghdr ph;
+  struct seg segs[NSEG];
   pde_t *pgdir, *oldpgdir;
   struct proc *curproc = myproc();
 
@@ -28,6 +30,7 @@ exec(char *path, char **argv)
   }
   ilock(ip);
   pgdir = 0;
+  exe = 0;
 
   // Check ELF header
   if(readi(ip, (char*)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -38,8 +41,10 @@ exec(char *path, char **argv)
   if((pgdir = setupkvm()) == 0) /*先创建Page Directory和kernel部分的映射*/
     goto bad;
 
-  // Load program into memory.
+  // Record where each segment comes from; its pages are
+  // read in from ip by uvmfault() when they are first touched.
   sz = 0;
+  nseg = 0;
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, (char*)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -47,6 +52,8 @@ exec(char *path, char **argv)
       continue;
     if(ph.memsz < ph.filesz)
       goto bad;
+    if(ph.memsz == 0)
+      continue;
     /*
      * This is a check for whether the sum overflow a 32-bit integer, if no check,
      * user could construct an ELF binary with a ph.vaddr that points into the kernel,
@@ -57,13 +64,22 @@ exec(char *path, char **argv)
      */
     if(ph.vaddr + ph.memsz < ph.vaddr)
       goto bad;
-    if((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0) /*allocate memory for each ELF segment*/
+    if(ph.vaddr + ph.memsz >= KERNBASE)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    if(loaduvm(pgdir, (char*)ph.vaddr, ip, ph.off, ph.filesz) < 0) /*load each segment into memory*/
+    if(nseg == NSEG)
       goto bad;
+    segs[nseg].va = ph.vaddr;
+    segs[nseg].memsz = ph.memsz;
+    segs[nseg].off = ph.off;
+    segs[nseg].filesz = ph.filesz;
+    segs[nseg].perm = (ph.flags & ELF_PROG_FLAG_WRITE) ? PTE_W : 0;
+    nseg++;
+    if(ph.vaddr + ph.memsz > sz)
+      sz = ph.vaddr + ph.memsz;
   }
+  exe = idup(ip);
   iunlockput(ip);
   end_op();
   ip = 0;
@@ -103,12 +119,22 @@ exec(char *path, char **argv)
 
   // Commit to the user image.
   oldpgdir = curproc->pgdir;
+  oldexe = curproc->exe;
   curproc->pgdir = pgdir;
   curproc->sz = sz;
+  curproc->exe = exe;
+  memmove(curproc->segs, segs, sizeof(segs));
+  curproc->nseg = nseg;
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
   switchuvm(curproc); /*Once the image is complete, exec() can install the new image*/
   freevm(oldpgdir); /*and free the old one*/
+  vmafree(curproc);
+  if(oldexe){
+    begin_op();
+    iput(oldexe);
+    end_op();
+  }
   return 0;
 
  bad:
@@ -118,5 +144,10 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  if(exe){
+    begin_op();
+    iput(exe);
+    end_op();
+  }
   return -1;
 }
@@ -0,0 +1,59 @@
+// Fork and exec latency benchmark.
+// Times fork+exit+wait round trips, then fork+exec+exit+wait
+// round trips of this program with an argument that makes it
+// exit at once, and reports the cost of each and the cost that
+// exec adds.  Building a new page directory is part of both.
+//
+// usage: execbench
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define RUNTIME 100    // ticks to spend timing each
+
+char *args[] = { "execbench", "-x", 0 };
+
+// Return microseconds per round trip over RUNTIME ticks,
+// exec'ing in the child if ex is set.
+int
+run(int ex)
+{
+  uint start, t;
+  int n, pid;
+
+  start = uptime();
+  for(n = 0; (t = uptime() - start) < RUNTIME; n++){
+    pid = fork();
+    if(pid < 0){
+      printf(2, "execbench: fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      if(ex){
+        exec(args[0], args);
+        printf(2, "execbench: exec failed\n");
+      }
+      exit();
+    }
+    wait();
+  }
+  return t * (1000000 / HZ) / n;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int f, e;
+
+  if(argc > 1 && strcmp(argv[1], "-x") == 0)
+    exit();
+
+  f = run(0);
+  e = run(1);
+  printf(1, "fork+exit+wait: %d us\n", f);
+  printf(1, "fork+exec+exit+wait: %d us\n", e);
+  printf(1, "exec: %d us\n", e - f);
+  exit();
+}
@@ -18,6 +18,7 @@ struct inode {
                        */
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
+  struct cpage *pages; // cached read-only pages (pagecache.c)
   
   // copy of disk inode
   short type;         // File type  dinode free:0   T_DIR:1   T_FILE:2   T_DEV:3
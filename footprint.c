@@ -0,0 +1,81 @@
+// Memory footprint benchmark.
+// Start N copies of a program (sh by default), each reading
+// commands from its own pipe that stays empty so that they all
+// sit in read(), and report the physical memory they take in
+// total and per copy.  With read-only text shared between
+// processes running the same binary, each copy costs only its
+// private data, stack and page tables; without it, each one
+// also pays for a copy of the text it has touched.
+//
+// usage: footprint [N] [prog]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define MAXN   (NOFILE-4)  // the parent keeps a write end per copy
+#define PGSIZE 4096
+
+int wfd[MAXN];
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, n, before, after, pipemem, m, fds[2];
+  char *prog, *args[2];
+
+  n = 8;
+  prog = "sh";
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(argc > 2)
+    prog = argv[2];
+  if(n < 1 || n > MAXN){
+    printf(2, "footprint: N must be 1..%d\n", MAXN);
+    exit();
+  }
+  args[0] = prog;
+  args[1] = 0;
+
+  // Each pipe is made just before its fork, so that the parent
+  // only keeps the write ends; what the pipes take is not
+  // counted.
+  pipemem = 0;
+  before = freemem();
+  for(i = 0; i < n; i++){
+    m = freemem();
+    if(pipe(fds) < 0){
+      printf(2, "footprint: pipe failed\n");
+      exit();
+    }
+    pipemem += m - freemem();
+    if(fork() == 0){
+      close(0);
+      dup(fds[0]);
+      close(fds[0]);
+      close(fds[1]);
+      for(j = 0; j < i; j++)
+        close(wfd[j]);
+      exec(prog, args);
+      printf(2, "footprint: exec %s failed\n", prog);
+      exit();
+    }
+    close(fds[0]);
+    wfd[i] = fds[1];
+  }
+  // Let every copy start up and block reading its pipe.
+  sleep(50);
+  after = freemem() + pipemem;
+
+  printf(1, "\n%d %s: %d KB, %d KB each\n", n, prog,
+         (before - after) * (PGSIZE / 1024),
+         (before - after) * (PGSIZE / 1024) / n);
+
+  // End of input makes each copy exit.
+  for(i = 0; i < n; i++)
+    close(wfd[i]);
+  for(i = 0; i < n; i++)
+    wait();
+  exit();
+}
@@ -0,0 +1,81 @@
+// Fork latency and memory benchmark.
+// For heap sizes of 1 MB to 64 MB, touch every page of the heap,
+// then time fork+exit+wait round trips and measure how much
+// physical memory a child costs while it is alive.  With
+// copy-on-write fork both should stay small as the heap grows;
+// copying fork grows linearly with it.
+//
+// usage: forkbench [maxmb]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define RUNTIME 50    // ticks to spend timing each size
+#define PGSIZE  4096
+
+// Fork one child that waits for a byte on a pipe, and return
+// the number of pages it took while it was alive.
+int
+childcost(void)
+{
+  int fds[2], before, after;
+  char c;
+
+  if(pipe(fds) < 0){
+    printf(2, "forkbench: pipe failed\n");
+    exit();
+  }
+  before = freemem();
+  if(fork() == 0){
+    close(fds[1]);
+    read(fds[0], &c, 1);
+    exit();
+  }
+  after = freemem();
+  close(fds[0]);
+  write(fds[1], "x", 1);
+  close(fds[1]);
+  wait();
+  return before - after;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb, maxmb, n, pid;
+  uint start, t;
+  char *heap, *p;
+
+  maxmb = 64;
+  if(argc > 1)
+    maxmb = atoi(argv[1]);
+
+  printf(1, "forkbench: %d ticks per size\n", RUNTIME);
+  heap = sbrk(0);
+  for(mb = 1; mb <= maxmb; mb *= 2){
+    // Grow the heap to mb MB and dirty every page of it.
+    if(sbrk(heap + mb*1024*1024 - (char*)sbrk(0)) == (char*)-1){
+      printf(2, "forkbench: sbrk %d MB failed\n", mb);
+      break;
+    }
+    for(p = heap; p < heap + mb*1024*1024; p += PGSIZE)
+      *p = 1;
+
+    start = uptime();
+    for(n = 0; (t = uptime() - start) < RUNTIME; n++){
+      pid = fork();
+      if(pid < 0){
+        printf(2, "forkbench: fork failed\n");
+        exit();
+      }
+      if(pid == 0)
+        exit();
+      wait();
+    }
+    printf(1, "%d MB: %d us per fork+exit+wait, child %d KB\n",
+           mb, t * (1000000 / HZ) / n, childcost() * (PGSIZE / 1024));
+  }
+  exit();
+}
@@ -1,11 +1,15 @@
-// Test that fork fails gracefully.
-// Tiny executable so that the limit can be filling the proc table.
+// Test that fork fails gracefully, then time a fork/exit/wait
+// storm run by 1..NCPU concurrent workers.
+// There is no limit on the number of processes, so fork fails
+// once the zombies have used up memory.
 
 #include "types.h"
 #include "stat.h"
 #include "user.h"
+#include "param.h"
 
-#define N  1000
+#define N  100000  // more processes than memory can hold
+#define ROUNDS 200   // fork/exit/wait cycles per storm worker
 
 void
 printf(int fd, const char *s, ...)
@@ -13,6 +17,20 @@ printf(int fd, const char *s, ...)
   write(fd, s, strlen(s));
 }
 
+void
+printint(int fd, int n)
+{
+  char buf[16];
+  int i;
+
+  i = sizeof(buf);
+  do {
+    buf[--i] = '0' + n % 10;
+    n /= 10;
+  } while(n > 0);
+  write(fd, buf + i, sizeof(buf) - i);
+}
+
 void
 forktest(void)
 {
@@ -48,9 +66,55 @@ forktest(void)
   printf(1, "fork test OK\n");
 }
 
+// Each of k workers forks, reaps and repeats ROUNDS times.
+// Workers on different CPUs only share the parent/child lock
+// briefly, so the rate should grow with k up to the CPU count.
+void
+forkstorm(void)
+{
+  int i, k, r, pid;
+  uint start, t;
+
+  printf(1, "fork storm\n");
+  for(k = 1; k <= NCPU; k++){
+    start = uptime();
+    for(i = 0; i < k; i++){
+      pid = fork();
+      if(pid < 0){
+        printf(1, "storm fork failed\n");
+        exit();
+      }
+      if(pid == 0){
+        for(r = 0; r < ROUNDS; r++){
+          pid = fork();
+          if(pid < 0){
+            printf(1, "storm fork failed\n");
+            exit();
+          }
+          if(pid == 0)
+            exit();
+          wait();
+        }
+        exit();
+      }
+    }
+    for(i = 0; i < k; i++)
+      wait();
+    t = uptime() - start;
+    if(t == 0)
+      t = 1;
+    printint(1, k);
+    printf(1, " workers: ");
+    printint(1, k * ROUNDS * HZ / t);
+    printf(1, " forks/sec\n");
+  }
+  printf(1, "fork storm OK\n");
+}
+
 int
 main(void)
 {
   forktest();
+  forkstorm();
   exit();
 }
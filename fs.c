@@ -14,8 +14,8 @@
 #include "param.h"
 #include "stat.h"
 #include "mmu.h"
-#include "proc.h"
 #include "spinlock.h"
+#include "proc.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
@@ -362,11 +362,13 @@ void
 iput(struct inode *ip)
 {
   acquiresleep(&ip->lock);
-  if(ip->valid && ip->nlink == 0){
-    acquire(&icache.lock);
-    int r = ip->ref;
-    release(&icache.lock);
-    if(r == 1){
+  acquire(&icache.lock);
+  int r = ip->ref;
+  release(&icache.lock);
+  if(r == 1){
+    // No other references: nothing can map its pages any more.
+    pcfree(ip);
+    if(ip->valid && ip->nlink == 0){
       // inode has no links and no other references: truncate and free.
       itrunc(ip);
       ip->type = 0;
@@ -446,6 +448,7 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  pcfree(ip);
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -534,6 +537,8 @@ writei(struct inode *ip, char *src, uint off, uint n)
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
+  // Later page faults must see the new contents.
+  pcfree(ip);
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
     bp = bread(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
@@ -8,6 +8,8 @@
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
 //                                          free bit map | data blocks]
+// followed by the swap area (see swap.c), which is not part of
+// the file system.
 //
 // mkfs computes the super block and builds an initial file system. The
 // super block describes the disk layout:
@@ -21,6 +23,10 @@ struct superblock {
   uint bmapstart;    // Block number of first free map block
 };
 
+// Swap area: NSWAP pages of 4096/BSIZE blocks each.
+#define SWAPSTART  FSSIZE
+#define SWAPBLOCKS (NSWAP*(4096/BSIZE))
+
 #define NDIRECT 12
 #define NINDIRECT (BSIZE / sizeof(uint)) /* 128 */
 #define MAXFILE (NDIRECT + NINDIRECT) /* 12 + 128 */
@@ -1,6 +1,14 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
-// and pipe buffers. Allocates 4096-byte pages.
+// and pipe buffers. Allocates 4096-byte pages, and physically
+// contiguous blocks of 2^order pages.
+//
+// Free memory is kept by a buddy allocator: one free list per
+// block size, where a block of 2^order pages starts on a
+// multiple of its size and its buddy is the other half of the
+// block of twice the size.  Freeing a block whose buddy is also
+// free merges the two.  Single pages go through per-CPU caches
+// in front of the buddy lists (see kalloc and kfree).
 
 #include "types.h"
 #include "defs.h"
@@ -10,6 +18,7 @@
 #include "spinlock.h"
 
 void freerange(void *vstart, void *vend);
+static char *kzeropop(void);
 extern char end[]; // first address after kernel loaded from ELF file
                    // defined by the kernel linker script in kernel.ld
 /*
@@ -20,6 +29,7 @@ extern char end[]; // first address after kernel loaded from ELF file
  */
 struct run {
   struct run *next;
+  struct run *prev;     // buddy lists only
 };
 
 /*
@@ -29,9 +39,123 @@ struct run {
 struct {
   struct spinlock lock; /*The free list of physical memory is protected by a apinlock*/
   int use_lock;
-  struct run *freelist;
+  struct run *free[MAXORDER+1];  // free blocks of 2^order pages
+  uint nblock[MAXORDER+1];       // blocks on each free list
+  uint nfree;                    // pages in all free blocks
 } kmem;
 
+// Top of physical memory, found by meminit() from the BIOS
+// memory map, and the number of pages below it.  Every page
+// below phystop is mapped at P2V(); the ones the BIOS does not
+// report as RAM are never handed out.
+uint phystop;
+static uint npages;
+
+// A BIOS memory map entry (see bootasm.S).
+struct e820 {
+  uint64 addr;
+  uint64 len;
+  uint type;                   // E820_RAM if usable
+} __attribute__((packed));
+
+#define E820_RAM 1
+#define E820MEM  0xE000000     // Memory assumed if there is no map
+
+static struct e820 *e820map;
+static int ne820;
+
+// For the first page of each block on a buddy free list,
+// 1 + the block's order; 0 for every other page.  Protected
+// by kmem.lock.  npages entries, allocated by meminit().
+static uchar *freeorder;
+
+// Per-CPU caches of free pages, so that most kalloc() and
+// kfree() calls do not touch kmem.lock.  A CPU refills its
+// cache from the buddy lists KBATCH pages at a time when it runs
+// dry, and gives KBATCH pages back once it holds 2*KBATCH.
+// Only used by the CPU it belongs to, with interrupts off.
+#define KBATCH 32
+
+struct kcpu {
+  struct run *freelist;
+  uint nfree;
+} kcpus[NCPU];
+
+// Pages that idle CPUs have already zeroed (see kzeroidle), for
+// kalloczero(), at most NZERO.  They count as allocated, with
+// one reference, but kalloc() falls back on them when nothing
+// else is free.
+struct {
+  struct spinlock lock;
+  struct run *list;
+  uint n;
+} kzero;
+
+// Reference counts of physical pages, indexed by physical page
+// number, for pages shared copy-on-write by fork.  kalloc()
+// hands out a page with one reference; kfree() drops one and
+// only frees the page once none are left.  A count of one
+// belongs to whoever holds that reference alone, so it can be
+// set and cleared without a lock; larger counts are changed
+// under kmem.lock.  npages entries, allocated by meminit().
+static ushort *pageref;
+
+// Find the top of RAM in the memory map bootasm.S got from the
+// BIOS, as much of it as the kernel can map below DEVSPACE, and
+// allocate the per-page arrays from vstart.  Returns the first
+// free address after them.
+static char*
+meminit(char *vstart)
+{
+  struct e820 *e;
+  uint64 top;
+
+  e820map = (struct e820*)P2V(E820MAP + 4);
+  ne820 = *(ushort*)P2V(E820MAP);
+  if(ne820 > E820MAX)
+    ne820 = E820MAX;
+  top = 0;
+  for(e = e820map; e < &e820map[ne820]; e++)
+    if(e->type == E820_RAM && e->addr + e->len > top)
+      top = e->addr + e->len;
+  if(ne820 == 0)
+    top = E820MEM;
+  if(top > DEVSPACE - KERNBASE)
+    top = DEVSPACE - KERNBASE;
+  phystop = PGROUNDDOWN((uint)top);
+  npages = phystop / PGSIZE;
+
+  vstart = (char*)PGROUNDUP((uint)vstart);
+  pageref = (ushort*)vstart;
+  vstart += npages * sizeof(pageref[0]);
+  freeorder = (uchar*)vstart;
+  vstart += npages * sizeof(freeorder[0]);
+  memset(pageref, 0, (char*)vstart - (char*)pageref);
+  return vstart;
+}
+
+// Is the physical page at pa RAM, according to the BIOS?  Any
+// part of it being reserved in any entry rules it out.
+static int
+isram(uint pa)
+{
+  struct e820 *e;
+  int ram;
+
+  if(ne820 == 0)
+    return pa < phystop;
+  ram = 0;
+  for(e = e820map; e < &e820map[ne820]; e++){
+    if(e->addr >= pa + PGSIZE || e->addr + e->len <= pa)
+      continue;
+    if(e->type != E820_RAM)
+      return 0;
+    if(e->addr <= pa && e->addr + e->len >= pa + PGSIZE)
+      ram = 1;
+  }
+  return ram;
+}
+
 // Initialization happens in two phases. 
 // 1. main() calls kinit1() while still using entrypgdir to place just
 // the pages mapped by entrypgdir on free list.
@@ -44,7 +168,11 @@ void
 kinit1(void *vstart, void *vend)
 {
   initlock(&kmem.lock, "kmem");
+  initlock(&kzero.lock, "kzero");
   kmem.use_lock = 0;
+  vstart = meminit(vstart);
+  if(vstart > vend)
+    panic("kinit1");
   freerange(vstart, vend);
 }
 
@@ -57,14 +185,118 @@ kinit2(void *vstart, void *vend)
 }
 
 /*freerange() add memory to the free list via per-page calls to kfree*/
+// Pages that are not RAM are skipped.
 void
 freerange(void *vstart, void *vend)
 {
   char *p;
   p = (char*)PGROUNDUP((uint)vstart);
   for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
-    kfree(p);
+    if(isram(V2P(p)))
+      kfree(p);
 }
+// Put the block of 2^order pages at r on its free list.
+static void
+buddypush(struct run *r, int order)
+{
+  r->prev = 0;
+  r->next = kmem.free[order];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[order] = r;
+  kmem.nblock[order]++;
+  freeorder[V2P(r) / PGSIZE] = order + 1;
+}
+
+// Take the block of 2^order pages at r off its free list.
+static void
+buddyremove(struct run *r, int order)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nblock[order]--;
+  freeorder[V2P(r) / PGSIZE] = 0;
+}
+
+// Allocate a block of 2^order pages, splitting a larger block
+// if there is none of that size.  Caller holds kmem.lock.
+static char*
+buddyalloc(int order)
+{
+  struct run *r;
+  int o;
+
+  for(o = order; o <= MAXORDER && kmem.free[o] == 0; o++)
+    ;
+  if(o > MAXORDER)
+    return 0;
+  r = kmem.free[o];
+  buddyremove(r, o);
+  // Give back the upper halves we do not need.
+  while(o > order){
+    o--;
+    buddypush((struct run*)((char*)r + (PGSIZE << o)), o);
+  }
+  kmem.nfree -= 1 << order;
+  return (char*)r;
+}
+
+// Free the block of 2^order pages at v, merging it with its
+// buddy for as long as the buddy is free too.  Caller holds
+// kmem.lock.
+static void
+buddyfree(char *v, int order)
+{
+  uint pn, buddy;
+
+  kmem.nfree += 1 << order;
+  pn = V2P(v) / PGSIZE;
+  while(order < MAXORDER){
+    buddy = pn ^ (1 << order);
+    if(buddy >= npages || freeorder[buddy] != order + 1)
+      break;
+    buddyremove((struct run*)P2V(buddy * PGSIZE), order);
+    pn &= ~(1 << order);
+    order++;
+  }
+  buddypush((struct run*)P2V(pn * PGSIZE), order);
+}
+
+// Move up to KBATCH pages from the buddy lists to c.
+static void
+krefill(struct kcpu *c)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  while(c->nfree < KBATCH && (r = (struct run*)buddyalloc(0)) != 0){
+    r->next = c->freelist;
+    c->freelist = r;
+    c->nfree++;
+  }
+  release(&kmem.lock);
+}
+
+// Give KBATCH of c's pages back to the buddy lists.
+static void
+kdrain(struct kcpu *c)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  while(c->nfree > KBATCH){
+    r = c->freelist;
+    c->freelist = r->next;
+    c->nfree--;
+    buddyfree((char*)r, 0);
+  }
+  release(&kmem.lock);
+}
+
 //PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
@@ -73,26 +305,74 @@ freerange(void *vstart, void *vend)
 void
 kfree(char *v)
 {
+  struct kcpu *c;
   struct run *r;
 
-  if((uint)v % PGSIZE || v < end || V2P(v) >= PHYSTOP)
+  if((uint)v % PGSIZE || v < end || V2P(v) >= phystop)
     panic("kfree");
 
+  // Pages handed to freerange() at boot have no references.
+  if(pageref[V2P(v) / PGSIZE] > 1){
+    acquire(&kmem.lock);
+    if(pageref[V2P(v) / PGSIZE] > 1){
+      pageref[V2P(v) / PGSIZE]--;
+      release(&kmem.lock);
+      return;
+    }
+    release(&kmem.lock);
+  }
+  pageref[V2P(v) / PGSIZE] = 0;
+
   // Fill with junk to catch dangling refs.
   /*
    * This will cause code that uses memory after freeing it(uses "dangling references")
    * to read garbage instead of the old valid contents; hopefully that will cause
    * such code to break faster
    */
-  memset(v, 1, PGSIZE);
+  if(KFREEJUNK)
+    memset(v, 1, PGSIZE);
 
-  if(kmem.use_lock)
-    acquire(&kmem.lock);
-  r = (struct run*)v; 
-  r->next = kmem.freelist; /*to record the old start of the free list in r->next*/
-  kmem.freelist = r; /*set the free list equal to r*/
-  if(kmem.use_lock)
-    release(&kmem.lock);
+  r = (struct run*)v;
+  if(kmem.use_lock){
+    pushcli();
+    c = &kcpus[cpuid()];
+    r->next = c->freelist;
+    c->freelist = r;
+    if(++c->nfree >= 2*KBATCH)
+      kdrain(c);
+    popcli();
+    return;
+  }
+  buddyfree(v, 0);
+}
+
+// Take a free page from this CPU's cache, refilling it from the
+// buddy lists if it is empty.  Returns 0 if there is none.
+static char*
+kallocfree(void)
+{
+  struct kcpu *c;
+  struct run *r;
+
+  if(!kmem.use_lock){
+    r = (struct run*)buddyalloc(0);
+    if(r)
+      pageref[V2P(r) / PGSIZE] = 1;
+    return (char*)r;
+  }
+
+  pushcli();
+  c = &kcpus[cpuid()];
+  if(c->freelist == 0)
+    krefill(c);
+  r = c->freelist;
+  if(r){
+    c->freelist = r->next;
+    c->nfree--;
+    pageref[V2P(r) / PGSIZE] = 1;
+  }
+  popcli();
+  return (char*)r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -103,16 +383,161 @@ kfree(char *v)
  */
 char*
 kalloc(void)
+{
+  char *mem;
+
+  if((mem = kallocfree()) == 0)
+    mem = kzeropop();
+  return mem;
+}
+
+// Take a page from the zeroed pool, or return 0 if it is empty.
+static char*
+kzeropop(void)
+{
+  struct run *r;
+
+  // Before kinit2() there are no other CPUs to fill the pool,
+  // and no locks can be taken.
+  if(!kmem.use_lock)
+    return 0;
+  acquire(&kzero.lock);
+  if((r = kzero.list) != 0){
+    kzero.list = r->next;
+    kzero.n--;
+  }
+  release(&kzero.lock);
+  // The link was the only part of the page that was not zero.
+  if(r)
+    r->next = 0;
+  return (char*)r;
+}
+
+// Allocate a page filled with zeroes, from the pool of pages
+// zeroed by idle CPUs if it has any.  Returns 0 if out of memory.
+char*
+kalloczero(void)
+{
+  char *mem;
+
+  if((mem = kzeropop()) == 0 && (mem = kalloc()) != 0)
+    memset(mem, 0, PGSIZE);
+  return mem;
+}
+
+// Zero one free page for the pool, unless it is full.  Called
+// by idle CPUs; returns 0 if there was nothing to do.
+int
+kzeroidle(void)
 {
   struct run *r;
 
+  if(kzero.n >= NZERO || !kmem.use_lock)
+    return 0;
+  if((r = (struct run*)kallocfree()) == 0)
+    return 0;
+  memset(r, 0, PGSIZE);
+  acquire(&kzero.lock);
+  r->next = kzero.list;
+  kzero.list = r;
+  kzero.n++;
+  release(&kzero.lock);
+  return 1;
+}
+
+// Allocate 2^order physically contiguous pages, aligned to
+// their size.  Each page has one reference.  Returns 0 if there
+// is no free block that large.
+char*
+kallocblk(int order)
+{
+  char *v;
+  int i;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
   if(kmem.use_lock)
     acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  v = buddyalloc(order);
   if(kmem.use_lock)
     release(&kmem.lock);
-  return (char*)r;
+  if(v)
+    for(i = 0; i < 1 << order; i++)
+      pageref[V2P(v) / PGSIZE + i] = 1;
+  return v;
+}
+
+// Free a block returned by kallocblk(order).  Its pages must
+// not be shared.
+void
+kfreeblk(char *v, int order)
+{
+  int i;
+
+  if(order < 0 || order > MAXORDER || (uint)v % (PGSIZE << order) ||
+     v < end || V2P(v) + (PGSIZE << order) > phystop)
+    panic("kfreeblk");
+  for(i = 0; i < 1 << order; i++){
+    if(pageref[V2P(v) / PGSIZE + i] != 1)
+      panic("kfreeblk: shared");
+    pageref[V2P(v) / PGSIZE + i] = 0;
+  }
+  if(KFREEJUNK)
+    memset(v, 1, PGSIZE << order);
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  buddyfree(v, order);
+  if(kmem.use_lock)
+    release(&kmem.lock);
+}
+
+// Copy the number of free blocks of each order, 0..MAXORDER,
+// into nblock.  Pages in the per-CPU caches are not counted.
+void
+kbuddyinfo(uint *nblock)
+{
+  int o;
+
+  acquire(&kmem.lock);
+  for(o = 0; o <= MAXORDER; o++)
+    nblock[o] = kmem.nblock[o];
+  release(&kmem.lock);
+}
+
+// Add a reference to the page at v, which must be allocated.
+void
+kincref(char *v)
+{
+  acquire(&kmem.lock);
+  if(pageref[V2P(v) / PGSIZE] == 0)
+    panic("kincref");
+  pageref[V2P(v) / PGSIZE]++;
+  release(&kmem.lock);
+}
+
+// Return the number of references to the page at v.
+int
+krefcount(char *v)
+{
+  int n;
+
+  acquire(&kmem.lock);
+  n = pageref[V2P(v) / PGSIZE];
+  release(&kmem.lock);
+  return n;
+}
+
+// Return the number of free pages, including those in the
+// per-CPU caches and the zeroed pool.
+int
+kfreepages(void)
+{
+  struct kcpu *c;
+  int n;
+
+  n = kmem.nfree + kzero.n;
+  for(c = kcpus; c < &kcpus[NCPU]; c++)
+    n += c->nfree;
+  return n;
 }
 
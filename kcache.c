@@ -0,0 +1,144 @@
+// Kernel object caches: a slab allocator for small objects.
+//
+// A cache hands out fixed-size objects carved from whole pages
+// obtained with kalloc(), so that many objects share a page.
+// Freed objects go on the cache's free list and are handed out
+// again by later allocations; a cache never gives its pages
+// back.  Objects are not initialized.
+//
+// In front of the shared free list, each CPU keeps up to KCMAG
+// objects of each cache, used with interrupts off and without
+// taking the cache lock.  A CPU refills half of its array from
+// the shared list when it runs dry and hands half back when it
+// fills up.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+
+#define NKCACHE 8
+#define KCMAG   16    // objects cached per CPU
+
+struct kobj {
+  struct kobj *next;
+};
+
+struct kcache {
+  struct spinlock lock;
+  char *name;
+  uint size;          // object size, rounded up to a pointer
+  struct kobj *free;
+  uint npage;         // pages taken from kalloc()
+  uint nfree;         // objects on free
+  struct {
+    void *obj[KCMAG];
+    int n;
+  } cpu[NCPU];        // per-CPU objects, not counted in nfree
+};
+
+static struct {
+  struct kcache cache[NKCACHE];
+  int n;
+} kcaches;
+
+// Create a cache of size-byte objects.  Only called during
+// boot, before the other CPUs start.
+struct kcache*
+kcachecreate(char *name, uint size)
+{
+  struct kcache *c;
+
+  if(size < sizeof(struct kobj))
+    size = sizeof(struct kobj);
+  size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  if(size > PGSIZE)
+    panic("kcachecreate: too big");
+
+  if(kcaches.n == NKCACHE)
+    panic("kcachecreate: too many");
+  c = &kcaches.cache[kcaches.n++];
+  initlock(&c->lock, name);
+  c->name = name;
+  c->size = size;
+  c->free = 0;
+  c->npage = 0;
+  c->nfree = 0;
+  return c;
+}
+
+// Move up to KCMAG/2 objects from c's free list to this CPU's
+// array, taking a new page if the free list is empty.  Called
+// with interrupts off.  Returns the number of objects moved.
+static int
+kcacherefill(struct kcache *c, int id)
+{
+  struct kobj *o;
+  char *page, *v;
+
+  acquire(&c->lock);
+  if(c->free == 0){
+    // Refill from a new page without holding the lock
+    // across kalloc().
+    release(&c->lock);
+    if((page = kalloc()) == 0)
+      return 0;
+    acquire(&c->lock);
+    for(v = page; v + c->size <= page + PGSIZE; v += c->size){
+      o = (struct kobj*)v;
+      o->next = c->free;
+      c->free = o;
+      c->nfree++;
+    }
+    c->npage++;
+  }
+  while(c->cpu[id].n < KCMAG/2 && (o = c->free) != 0){
+    c->free = o->next;
+    c->nfree--;
+    c->cpu[id].obj[c->cpu[id].n++] = o;
+  }
+  release(&c->lock);
+  return c->cpu[id].n;
+}
+
+// Allocate an object from c.  Returns 0 if out of memory.
+void*
+kcachealloc(struct kcache *c)
+{
+  void *v;
+  int id;
+
+  pushcli();
+  id = cpuid();
+  if(c->cpu[id].n == 0 && kcacherefill(c, id) == 0){
+    popcli();
+    return 0;
+  }
+  v = c->cpu[id].obj[--c->cpu[id].n];
+  popcli();
+  return v;
+}
+
+// Return object v to c.
+void
+kcachefree(struct kcache *c, void *v)
+{
+  struct kobj *o;
+  int id;
+
+  pushcli();
+  id = cpuid();
+  if(c->cpu[id].n == KCMAG){
+    acquire(&c->lock);
+    while(c->cpu[id].n > KCMAG/2){
+      o = c->cpu[id].obj[--c->cpu[id].n];
+      o->next = c->free;
+      c->free = o;
+      c->nfree++;
+    }
+    release(&c->lock);
+  }
+  c->cpu[id].obj[c->cpu[id].n++] = v;
+  popcli();
+}
@@ -42,6 +42,8 @@
 #define TDCR    (0x03E0/4)   // Timer Divide Configuration
 
 volatile uint *lapic;  // Initialized in mp.c
+uint lapictick;        // LAPIC timer counts per clock tick
+uint tsctick;          // TSC cycles per clock tick
 
 //PAGEBREAK!
 static void
@@ -50,6 +52,38 @@ lapicw(int index, int value)
   lapic[index] = value;
   lapic[ID];  // wait for write to finish, by reading
 }
+#define PIT_HZ    1193182  // 8253 PIT input clock
+#define PIT_CH2   0x42     // channel 2 data port
+#define PIT_MODE  0x43     // mode/command port
+#define PIT_GATE  0x61     // bit 0: channel 2 gate, bit 5: channel 2 output
+
+// Measure how far the LAPIC timer and the TSC advance in one
+// clock tick (1/HZ seconds), using PIT channel 2 in one-shot
+// mode as the reference.  All CPUs share one bus clock, so the
+// boot CPU does this once for everyone.
+static void
+calibrate(void)
+{
+  uint count;
+  uint64 t0;
+
+  count = PIT_HZ / HZ;
+  outb(PIT_GATE, inb(PIT_GATE) & ~0x03);  // gate off, speaker off
+  outb(PIT_MODE, 0xB0);                   // channel 2, lo/hi byte, mode 0
+  outb(PIT_CH2, count & 0xFF);
+  outb(PIT_CH2, count >> 8);
+
+  lapicw(TIMER, MASKED | (T_IRQ0 + IRQ_TIMER));
+  lapicw(TICR, 0xFFFFFFFF);
+  t0 = rdtsc();
+  outb(PIT_GATE, inb(PIT_GATE) | 0x01);   // start channel 2 counting
+  while((inb(PIT_GATE) & 0x20) == 0)      // until its output goes high
+    ;
+  tsctick = rdtsc() - t0;
+  lapictick = 0xFFFFFFFF - lapic[TCCR];
+  lapicw(TICR, 0);
+}
+
 /*the timer chip is inside the LAPIC, so that each processor can receive timer interrupts independently*/
 void
 lapicinit(void)
@@ -60,13 +94,20 @@ lapicinit(void)
   // Enable local APIC; set spurious interrupt vector.
   lapicw(SVR, ENABLE | (T_IRQ0 + IRQ_SPURIOUS));
 
-  // The timer repeatedly counts down at bus frequency
-  // from lapic[TICR] and then issues an interrupt.
-  // If xv6 cared more about precise timekeeping,
-  // TICR would be calibrated using an external time source.
+  // The timer counts down at bus frequency from lapic[TICR]
+  // and then issues an interrupt.  TICR is calibrated against
+  // the PIT so that lapictick counts are one clock tick.
   lapicw(TDCR, X1);
-  lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER)); /*program the timer, the line tells the LAPIC to periodically generate an interrupt at IRQ_TIMER, which is IRQ_0*/
-  lapicw(TICR, 10000000);
+  if(lapictick == 0)
+    calibrate();
+  if(TICKLESS){
+    // One-shot: the first tick is armed here, after which
+    // trap() and the scheduler arm each deadline (lapictimer).
+    lapicw(TIMER, T_IRQ0 + IRQ_TIMER);
+  } else {
+    lapicw(TIMER, PERIODIC | (T_IRQ0 + IRQ_TIMER)); /*program the timer, the line tells the LAPIC to periodically generate an interrupt at IRQ_TIMER, which is IRQ_0*/
+  }
+  lapicw(TICR, lapictick);
 
   // Disable logical interrupt lines.
   lapicw(LINT0, MASKED);
@@ -106,6 +147,19 @@ lapicid(void)
   return lapic[ID] >> 24;
 }
 
+// Arm this CPU's one-shot timer to interrupt n clock ticks
+// from now, or stop it if n is 0.  Deadlines too far away to
+// fit in TICR fire early; the caller just re-arms.
+void
+lapictimer(uint n)
+{
+  if(!lapic)
+    return;
+  if(n > 0xFFFFFFFF / lapictick)
+    n = 0xFFFFFFFF / lapictick;
+  lapicw(TICR, n * lapictick);
+}
+
 // Acknowledge interrupt.
 void
 lapiceoi(void)
@@ -121,6 +175,23 @@ microdelay(int us)
 {
 }
 
+// Send interrupt vector to the CPU whose local APIC ID is apicid.
+void
+lapicipi(uchar apicid, int vector)
+{
+  if(!lapic)
+    return;
+
+  // An interrupt handler on this CPU may also send an IPI;
+  // keep it from interleaving its ICR writes with ours.
+  pushcli();
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | ASSERT | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+  popcli();
+}
+
 #define CMOS_PORT    0x70
 #define CMOS_RETURN  0x71
 
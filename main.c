@@ -3,6 +3,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "x86.h"
 
@@ -40,15 +41,19 @@ main(void)
   tvinit();        // trap vectors
   /* 初始化块设备缓冲区 */
   binit();         // buffer cache
+  pcinit();        // read-only file page cache
   fileinit();      // file table
+  pipeinit();      // pipe buffers
+  shminit();       // shared memory segments
+  swapinit();      // swap space
   /*initialize the disk driver*/
   ideinit();       // disk 
   startothers();   // start other processors
   /*
    * The allocator refers to physical pages by their virtual addresses
-   * as mapped in high memory, not by their physical addresses, this is why use P2V(PHYSTOP) 
+   * as mapped in high memory, not by their physical addresses, this is why use P2V(phystop) 
    */
-  kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
+  kinit2(P2V(4*1024*1024), P2V(phystop)); // must come after startothers()
   userinit();      // create the first user process
   mpmain();        // finish this processor's setup
 }
@@ -1,9 +1,14 @@
 // Memory layout
 
 #define EXTMEM  0x100000            // Start of extended memory, 1MB
-#define PHYSTOP 0xE000000           // Top physical memory, 224MB
 #define DEVSPACE 0xFE000000         // Other devices are at high addresses, 4064MB
 
+// The BIOS memory map, left by bootasm.S: a 16-bit count at
+// E820MAP, then that many E820SIZE-byte entries from E820MAP+4.
+#define E820MAP  0x8000
+#define E820SIZE 20
+#define E820MAX  64                 // Most entries read
+
 // Key addresses for address space layout (see kmap in vm.c for layout)
 #define KERNBASE 0x80000000         // First kernel virtual address, 2GB
 #define KERNLINK (KERNBASE+EXTMEM)  // Address where kernel is linked
@@ -110,6 +110,8 @@ main(int argc, char *argv[])
 
   for(i = 0; i < FSSIZE; i++)
     wsect(i, zeroes);
+  // Make the image big enough to hold the swap area too.
+  wsect(SWAPSTART + SWAPBLOCKS - 1, zeroes);
 
   memset(buf, 0, sizeof(buf));
   memmove(buf, &sb, sizeof(sb));
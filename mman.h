@@ -0,0 +1,6 @@
+// mmap() protections and flags.
+#define PROT_READ       0x1   // Pages may be read
+#define PROT_WRITE      0x2   // Pages may be written
+
+#define MAP_PRIVATE     0x02  // Changes are private to the process
+#define MAP_ANONYMOUS   0x20  // Zeroed memory, not backed by a file
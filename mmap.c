@@ -0,0 +1,198 @@
+// Memory mappings.
+//
+// mmap() maps zeroed anonymous memory, or a read-only view of
+// a file, into a process between the top of its heap and
+// KERNBASE; shmat() maps shared segments there the same way.
+// Each mapping is a vma in the process's vmas[] array; its pages
+// are allocated, or taken from the file's page cache or the
+// segment, when first touched (see uvmfault).  The heap below
+// p->sz may not grow into a mapping.
+//
+// Only the process itself changes its vmas, so, like p->sz,
+// they need no lock.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "mman.h"
+
+// Return the mapping of p that holds va, or 0.
+struct vma*
+vmalookup(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++)
+    if(v->end && v->start <= va && va < v->end)
+      return v;
+  return 0;
+}
+
+// Return a mapping of p that overlaps [start, end), or 0.
+struct vma*
+vmaoverlap(struct proc *p, uint start, uint end)
+{
+  struct vma *v;
+
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++)
+    if(v->end && v->start < end && start < v->end)
+      return v;
+  return 0;
+}
+
+// Return the end of the part of p's memory that holds va: p->sz
+// for the program, stack and heap, the end of the mapping for a
+// mapped page, and 0 if va is not part of p's memory.
+uint
+userend(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  if(va < p->sz)
+    return p->sz;
+  if((v = vmalookup(p, va)) != 0)
+    return v->end;
+  return 0;
+}
+
+// Take another reference to what v maps, for a copy of v.
+static void
+vmadupref(struct vma *v)
+{
+  if(v->f)
+    filedup(v->f);
+  if(v->shm)
+    shmdup(v->shm);
+}
+
+// Drop v's reference to what it maps and free the slot.
+static void
+vmaclose(struct vma *v)
+{
+  if(v->f)
+    fileclose(v->f);
+  if(v->shm)
+    shmclose(v->shm);
+  memset(v, 0, sizeof(*v));
+}
+
+// Map len bytes of anonymous memory, or of file f or shared
+// segment sh from offset off, into the current process with
+// protection prot.  Takes the highest free range below KERNBASE
+// that is large enough.  Returns the address of the mapping,
+// or -1.
+int
+mmap(struct file *f, struct shm *sh, uint len, int prot, uint off)
+{
+  struct proc *p = myproc();
+  struct vma *v, *nv;
+  uint start, end;
+
+  if(len == 0 || len > KERNBASE)
+    return -1;
+  len = PGROUNDUP(len);
+  for(nv = p->vmas; nv < &p->vmas[NVMA] && nv->end; nv++)
+    ;
+  if(nv == &p->vmas[NVMA])
+    return -1;
+
+  end = KERNBASE;
+  for(;;){
+    if(end < len || end - len < PGROUNDUP(p->sz))
+      return -1;
+    start = end - len;
+    if((v = vmaoverlap(p, start, end)) == 0)
+      break;
+    end = v->start;
+  }
+
+  nv->start = start;
+  nv->end = end;
+  nv->prot = prot;
+  nv->f = f ? filedup(f) : 0;
+  nv->shm = sh ? shmdup(sh) : 0;
+  nv->off = off;
+  return start;
+}
+
+// Remove the pages [addr, addr+len) from the current process's
+// mappings, trimming or splitting mappings that only partly
+// overlap the range.  Returns -1 if the range is bad or a split
+// needs a free vma and there is none.
+int
+munmap(uint addr, uint len)
+{
+  struct proc *p = myproc();
+  struct vma *v, *nv;
+  uint end, s, e;
+
+  if(addr % PGSIZE || len == 0 || addr >= KERNBASE || len > KERNBASE - addr)
+    return -1;
+  end = PGROUNDUP(addr + len);
+
+  // Find a free slot first if the range splits a mapping.
+  nv = 0;
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++){
+    if(v->end && v->start < addr && end < v->end){
+      for(nv = p->vmas; nv < &p->vmas[NVMA] && nv->end; nv++)
+        ;
+      if(nv == &p->vmas[NVMA])
+        return -1;
+    }
+  }
+
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++){
+    if(v->end == 0 || v->end <= addr || end <= v->start)
+      continue;
+    s = v->start > addr ? v->start : addr;
+    e = v->end < end ? v->end : end;
+    deallocuvm(p->pgdir, e, s);
+    if(s == v->start && e == v->end){
+      vmaclose(v);
+    } else if(s == v->start){
+      v->off += e - v->start;
+      v->start = e;
+    } else if(e == v->end){
+      v->end = s;
+    } else {
+      *nv = *v;
+      nv->start = e;
+      nv->off += e - v->start;
+      vmadupref(nv);
+      v->end = s;
+    }
+  }
+  switchuvm(p);
+  return 0;
+}
+
+// Give child np copies of the current process's mappings.
+// copyuvm() shares their pages, copy-on-write except for shared
+// segments.
+void
+vmadup(struct proc *np)
+{
+  struct proc *p = myproc();
+  struct vma *v;
+
+  memmove(np->vmas, p->vmas, sizeof(p->vmas));
+  for(v = np->vmas; v < &np->vmas[NVMA]; v++)
+    if(v->end)
+      vmadupref(v);
+}
+
+// Drop all of p's mappings, for exec() and exit().  Their pages
+// go with the page table, in freevm().
+void
+vmafree(struct proc *p)
+{
+  struct vma *v;
+
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++)
+    if(v->end)
+      vmaclose(v);
+}
@@ -0,0 +1,147 @@
+// Tests for mmap() and munmap(), then a comparison of summing a
+// file with read() against summing it through a mapping, which
+// reads from the file's page cache without copying.
+//
+// usage: mmaptest [file]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "mman.h"
+
+#define PGSIZE 4096
+#define PASSES 200
+
+char buf[PGSIZE];
+
+void
+fail(char *what)
+{
+  printf(1, "mmaptest: %s FAILED\n", what);
+  exit();
+}
+
+void
+anontest(void)
+{
+  char *p;
+  int i, pid;
+
+  printf(1, "anonymous mapping\n");
+  p = mmap(0, 10*PGSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if(p == (char*)-1)
+    fail("mmap");
+  for(i = 0; i < 10*PGSIZE; i += PGSIZE)
+    if(p[i] != 0)
+      fail("zeroed");
+  for(i = 0; i < 10*PGSIZE; i++)
+    p[i] = i;
+
+  // The child gets a private copy.
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0){
+    for(i = 0; i < 10*PGSIZE; i++)
+      if(p[i] != (char)i)
+        fail("child sees data");
+    p[0] = 99;
+    exit();
+  }
+  wait();
+  if(p[0] != 0)
+    fail("private after fork");
+
+  // Unmap the middle, then the rest.
+  if(munmap(p + 4*PGSIZE, 2*PGSIZE) < 0)
+    fail("munmap middle");
+  if(p[3*PGSIZE] != (char)(3*PGSIZE) || p[6*PGSIZE] != (char)(6*PGSIZE))
+    fail("pages around hole");
+  pid = fork();
+  if(pid == 0){
+    p[4*PGSIZE] = 1;
+    fail("hole still mapped");
+  }
+  wait();
+  if(munmap(p, 4*PGSIZE) < 0 || munmap(p + 6*PGSIZE, 4*PGSIZE) < 0)
+    fail("munmap rest");
+  printf(1, "anonymous mapping ok\n");
+}
+
+void
+filetest(char *file)
+{
+  int fd, i, n, off;
+  char *p;
+
+  printf(1, "file mapping\n");
+  if((fd = open(file, O_RDONLY)) < 0)
+    fail("open");
+  if(mmap(0, PGSIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0) != (char*)-1)
+    fail("writable file mapping allowed");
+  p = mmap(0, 64*PGSIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(p == (char*)-1)
+    fail("mmap");
+  for(off = 0; off < 64*PGSIZE && (n = read(fd, buf, sizeof(buf))) > 0; off += n)
+    for(i = 0; i < n; i++)
+      if(p[off + i] != buf[i])
+        fail("contents");
+  close(fd);
+  // The mapping outlives the descriptor; past EOF reads zeroes.
+  if(off < 64*PGSIZE && p[off] != 0)
+    fail("zero past end of file");
+  if(munmap(p, 64*PGSIZE) < 0)
+    fail("munmap");
+  printf(1, "file mapping ok\n");
+}
+
+void
+bench(char *file)
+{
+  struct stat st;
+  uint start, sum;
+  int fd, i, j, n;
+  char *p;
+
+  if((fd = open(file, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+    fail("open");
+  sum = 0;
+  start = uptime();
+  for(i = 0; i < PASSES; i++){
+    close(fd);
+    if((fd = open(file, O_RDONLY)) < 0)
+      fail("open");
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+      for(j = 0; j < n; j++)
+        sum += buf[j];
+  }
+  printf(1, "read: %d ticks for %d passes over %d bytes\n",
+         uptime() - start, PASSES, st.size);
+
+  p = mmap(0, st.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(p == (char*)-1)
+    fail("mmap");
+  start = uptime();
+  for(i = 0; i < PASSES; i++)
+    for(j = 0; j < st.size; j++)
+      sum += p[j];
+  printf(1, "mmap: %d ticks for %d passes over %d bytes%s\n",
+         uptime() - start, PASSES, st.size, sum ? "" : "?");
+  munmap(p, st.size);
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *file;
+
+  file = "usertests";
+  if(argc > 1)
+    file = argv[1];
+  anontest();
+  filetest(file);
+  bench(file);
+  exit();
+}
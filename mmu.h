@@ -14,6 +14,7 @@
 #define CR0_PG          0x80000000      // Paging
 /*CR4寄存器第4位用于设置是否开启PSE*/
 #define CR4_PSE         0x00000010      // Page size extension 
+#define CR4_PGE         0x00000080      // Page global enable
 
 // various segment selectors.
 #define SEG_KCODE 1  // kernel code，可执行和可读
@@ -96,6 +97,7 @@ struct segdesc {
 // Page directory and page table constants.
 #define NPDENTRIES      1024    // # directory entries per page directory
 #define NPTENTRIES      1024    // # PTEs per page table
+#define SPGSIZE         (PGSIZE*NPTENTRIES) // bytes mapped by a PTE_PS superpage
 #define PGSIZE          4096    // bytes mapped by a page
 
 #define PTXSHIFT        12      // offset of PTX in a linear address
@@ -108,12 +110,23 @@ struct segdesc {
 #define PTE_P           0x001   /*indicate whether the PTE is present, if it's not set, reference to the page causes a fault*/
 #define PTE_W           0x002   /*control whether instructions are allowed to issue writes to the page, if not set, only reads and instruction fetches are allowed*/
 #define PTE_U           0x004   /*control whether the user programs are allowed to use the page, if clear, only the kernel is allowed to use the page*/
+#define PTE_A           0x020   // Accessed
+#define PTE_D           0x040   // Dirty
 #define PTE_PS          0x080   // Page Size /*kernel 将虚拟地址的第7为设置为1, 表示从PDE直接指向内存中的一个super page*/
+#define PTE_G           0x100   // Global: kept in the TLB across %cr3 loads
+#define PTE_COW         0x200   // Copy-on-write (bit available to software)
+#define PTE_SWAP        0x400   // Not present, in swap (bit available to software)
+
+// Page fault error code bits
+#define FEC_WR          0x002   // Fault caused by a write
 
 // Address in page table or page directory entry
 #define PTE_ADDR(pte)   ((uint)(pte) & ~0xFFF)
 #define PTE_FLAGS(pte)  ((uint)(pte) &  0xFFF)
 
+// Swap slot in a PTE_SWAP entry, which holds it in place of the address
+#define PTE_SLOT(pte)   (PTE_ADDR(pte) >> PTXSHIFT)
+
 #ifndef __ASSEMBLER__
 typedef uint pte_t;
 
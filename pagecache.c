@@ -0,0 +1,94 @@
+// Page cache for read-only file pages.
+//
+// Each inode keeps a list of the pages of it that processes
+// have mapped read-only, from a program segment or with mmap()
+// (see uvmfault).  Every process mapping the page maps the same
+// physical page, so N processes running a program cost one copy
+// of its text, and mapping a file costs no copy beyond the
+// cache.  The cache
+// holds a reference on each page (see kincref in kalloc.c);
+// a page is freed when the cache and every mapping have let
+// go of it.
+//
+// The list is protected by the inode's sleep-lock.  Pages are
+// dropped when the file is written or truncated, and when the
+// last reference to the inode goes away.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+
+struct cpage {
+  struct cpage *next;
+  uint off;           // file offset of the page
+  uint n;             // bytes read from the file; the rest is zero
+  char *mem;
+};
+
+static struct kcache *cpagecache;
+
+void
+pcinit(void)
+{
+  cpagecache = kcachecreate("cpage", sizeof(struct cpage));
+}
+
+// Return the page holding n bytes of ip at offset off, followed
+// by zeroes, reading it in if it is not cached.  The caller gets
+// its own reference to the page and must not write to it.
+// Caller must hold ip->lock.  Returns 0 if out of memory or
+// the file cannot be read.
+char*
+pcget(struct inode *ip, uint off, uint n)
+{
+  struct cpage *c;
+  char *mem;
+
+  if(!holdingsleep(&ip->lock))
+    panic("pcget");
+
+  for(c = ip->pages; c; c = c->next){
+    if(c->off == off && c->n == n){
+      kincref(c->mem);
+      return c->mem;
+    }
+  }
+
+  if((mem = kalloczero()) == 0)
+    return 0;
+  if(n > 0 && readi(ip, mem, off, n) != n){
+    kfree(mem);
+    return 0;
+  }
+  if((c = kcachealloc(cpagecache)) == 0){
+    // Still usable, just not shared.
+    return mem;
+  }
+  c->off = off;
+  c->n = n;
+  c->mem = mem;
+  c->next = ip->pages;
+  ip->pages = c;
+  kincref(mem);
+  return mem;
+}
+
+// Drop all of ip's cached pages.  Pages that processes still
+// have mapped stay theirs until they unmap them.  Caller must
+// hold ip->lock.
+void
+pcfree(struct inode *ip)
+{
+  struct cpage *c;
+
+  while((c = ip->pages) != 0){
+    ip->pages = c->next;
+    kfree(c->mem);
+    kcachefree(cpagecache, c);
+  }
+}
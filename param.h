@@ -1,14 +1,33 @@
-#define NPROC        64  // maximum number of processes
+#define NPIDHASH     64  // buckets in the pid hash table (power of 2)
 #define KSTACKSIZE 4096  // size of per-process kernel stack
 #define NCPU          8  // maximum number of CPUs
+#define NSLEEPQ      64  // buckets in the wait channel hash table (power of 2)
+#define NPRIO         4  // MLFQ priority levels, 0 is highest
+#define BOOSTTICKS  100  // ticks between MLFQ priority boosts
+#define DEFTICKETS  100  // default stride scheduling tickets
+#define HZ          100  // clock ticks per second
+#define TICKLESS      1  // one-shot timer; idle CPUs stop ticking
+#define LAZYSBRK      1  // sbrk() heap pages are allocated on first touch
+#define SHARETEXT     1  // read-only program pages are shared (pagecache.c)
+#define MAXORDER     10  // largest kallocblk() block is 2^MAXORDER pages
+#ifndef NZERO
+#define NZERO       256  // pages idle CPUs keep zeroed (make NZERO=0 for none)
+#endif
+#ifndef KFREEJUNK
+#define KFREEJUNK     0  // kfree() fills pages with junk (make KFREEJUNK=1)
+#endif
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
+#define NSEG          4  // max loadable segments in a program
+#define NVMA          8  // mmap() regions per process
+#define NSHM         16  // shared memory segments
+#define SHMPAGES     64  // max pages in a shared memory segment
 #define MAXOPBLOCKS  10  // max # of blocks any FS op/syscall writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log, MAXOPBLOCKS=10
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache, MAXOPBLOCKS=10
-#define FSSIZE       1000  // size of file system in blocks
+#define FSSIZE       2000  // size of file system in blocks
+#define NSWAP        4096  // pages of swap space, after the file system
 
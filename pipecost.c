@@ -0,0 +1,50 @@
+// Pipe memory and allocation latency benchmark.
+// Open NPIPE pipes and report the physical memory each one
+// costs, then time pipe()+close()+close() round trips.  With
+// pipes carved from an object cache many share a page; with a
+// page per pipe each costs 4096 bytes.
+//
+// usage: pipecost
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define NPIPE   ((NOFILE-3)/2)  // each takes 2 fds; 0-2 are open
+#define RUNTIME 100   // ticks to spend timing
+#define PGSIZE  4096
+
+int
+main(void)
+{
+  int fds[NPIPE][2], i, n, before, after;
+  uint start, t;
+
+  before = freemem();
+  for(i = 0; i < NPIPE; i++){
+    if(pipe(fds[i]) < 0){
+      printf(2, "pipecost: pipe failed\n");
+      exit();
+    }
+  }
+  after = freemem();
+  printf(1, "%d pipes: %d bytes each\n", NPIPE,
+         (before - after) * PGSIZE / NPIPE);
+  for(i = 0; i < NPIPE; i++){
+    close(fds[i][0]);
+    close(fds[i][1]);
+  }
+
+  start = uptime();
+  for(n = 0; (t = uptime() - start) < RUNTIME; n++){
+    if(pipe(fds[0]) < 0){
+      printf(2, "pipecost: pipe failed\n");
+      exit();
+    }
+    close(fds[0][0]);
+    close(fds[0][1]);
+  }
+  printf(1, "pipe+close+close: %d ns\n", t * (1000000000 / HZ) / n);
+  exit();
+}
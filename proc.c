@@ -4,13 +4,64 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
-#include "proc.h"
 #include "spinlock.h"
-
-struct {
+#include "proc.h"
+#include "traps.h"
+#include "sched.h"
+
+// Each process has its own lock, p->lock, which protects its
+// state, chan, killed and pid, and is held across the context
+// switch into and out of the process.  p->parent and the child
+// lists, for every process, are protected by parentlock instead,
+// so that fork, exit and wait on unrelated processes do not contend.
+// Lock order: parentlock, pidlock, a sleep queue lock, p->lock,
+// a run queue lock.
+//
+// There is no fixed process table: struct procs come from a
+// kernel object cache, and every process from allocproc() until
+// it is reaped by wait() is on the pid hash table, which is how
+// kill() and friends find it.  It is also on a list of all
+// processes in pid order, for the swap clock (see swapnext).
+// pidlock protects the hash table, the list and nextpid.
+static struct kcache *proccache;
+static struct proc *pidhash[NPIDHASH];
+static struct proc *allprocs, *allprocstail;
+static struct proc *swaphand;  // Next process for swapnext()
+static struct spinlock parentlock;
+static struct spinlock pidlock;
+
+#define PIDHASH(pid) ((pid) & (NPIDHASH-1))
+
+// Per-CPU run queues.  Every RUNNABLE process sits on exactly one
+// of these, so the scheduler finds work without scanning every process.
+// A run queue's lock only protects the queue links, n and pass;
+// p->state is protected by p->lock.
+//
+// The order in which a run queue is served is up to the active
+// scheduling policy (see policies below).  A queue has one list per
+// priority level and is always served highest level first; policies
+// that do not use levels keep everything on level 0.
+struct runq {
+  struct spinlock lock;
+  struct proc *head[NPRIO];  // next process to run at each level
+  struct proc *tail[NPRIO];
+  int n;                     // number of queued processes
+  uint pass;                 // stride: pass of the last process run
+};
+
+static struct runq runqs[NCPU];
+
+// Wait channel hash table.  A SLEEPING process is linked into the
+// bucket for its p->chan, so wakeup() costs O(sleepers in that
+// bucket) instead of a scan of every process.  A process is on a bucket
+// exactly while it is SLEEPING, and p->chan does not change while
+// it is there, so the bucket lock alone is enough to find it.
+static struct sleepq {
   struct spinlock lock;
-  struct proc proc[NPROC];
-} ptable;
+  struct proc *head;
+} sleepq[NSLEEPQ];
+
+#define SLEEPHASH(chan) ((((uint)(chan) * 2654435761U) >> 16) & (NSLEEPQ-1))
 
 static struct proc *initproc; /* 这个全局变量在userinit()函数中赋值 */
 
@@ -18,15 +69,303 @@ int nextpid = 1;
 extern void forkret(void);
 extern void trapret(void);
 
-static void wakeup1(void *chan);
-
 void
 pinit(void)
 {
+  int i;
+
   /*
     初始化进程全局变量进程锁
   */
-  initlock(&ptable.lock, "ptable");
+  proccache = kcachecreate("proc", sizeof(struct proc));
+  initlock(&parentlock, "parent");
+  initlock(&pidlock, "pid");
+  for(i = 0; i < NSLEEPQ; i++)
+    initlock(&sleepq[i].lock, "sleepq");
+  for(i = 0; i < NCPU; i++)
+    initlock(&runqs[i].lock, "runq");
+}
+
+// Append p to rq at the given level.  rq->lock must be held.
+static void
+rqappend(struct runq *rq, struct proc *p, int level)
+{
+  p->rqnext = 0;
+  if(rq->tail[level])
+    rq->tail[level]->rqnext = p;
+  else
+    rq->head[level] = p;
+  rq->tail[level] = p;
+  rq->n++;
+}
+
+// Remove and return the first process at the highest non-empty
+// level of rq, or 0 if rq is empty.  rq->lock must be held.
+static struct proc*
+rqtake(struct runq *rq)
+{
+  struct proc *p;
+  int i;
+
+  for(i = 0; i < NPRIO; i++){
+    if((p = rq->head[i]) != 0){
+      rq->head[i] = p->rqnext;
+      if(rq->head[i] == 0)
+        rq->tail[i] = 0;
+      rq->n--;
+      p->rqnext = 0;
+      return p;
+    }
+  }
+  return 0;
+}
+
+// Is a process of higher priority than prio waiting on cpu's
+// run queue?  Reads the queue heads without the lock; the answer
+// is only a hint for preemption.
+static int
+rqhigher(int cpu, int prio)
+{
+  int i;
+
+  for(i = 0; i < prio; i++)
+    if(runqs[cpu].head[i])
+      return 1;
+  return 0;
+}
+
+//PAGEBREAK: 30
+// Scheduling policies.  enqueue and dequeue are called with the
+// run queue locked; tick is called on every clock tick for the
+// running process and returns 1 if it should give up the CPU.
+// The policy is chosen at build time (SCHEDPOLICY in sched.h)
+// and can be switched at runtime with setsched().
+struct schedpolicy {
+  char *name;
+  void (*enqueue)(struct runq*, struct proc*);
+  struct proc *(*dequeue)(struct runq*);
+  int (*tick)(struct proc*, int);
+};
+
+// Round robin: one FIFO, and every tick ends the time slice.
+static void
+rrenqueue(struct runq *rq, struct proc *p)
+{
+  rqappend(rq, p, 0);
+}
+
+static int
+rrtick(struct proc *p, int cpu)
+{
+  return 1;
+}
+
+// Multi-level feedback queue.  A process that uses up the
+// QUANTUM of its level drops a level; every BOOSTTICKS all
+// processes go back to the top (see boost()).
+#define QUANTUM(prio) (1 << (prio))
+
+static void
+mlfqenqueue(struct runq *rq, struct proc *p)
+{
+  rqappend(rq, p, p->prio);
+}
+
+// The slice is kept across sleeps, so a process cannot stay on
+// top by sleeping just before its quantum runs out.
+static int
+mlfqtick(struct proc *p, int cpu)
+{
+  if(++p->slice >= QUANTUM(p->prio)){
+    if(p->prio < NPRIO-1)
+      p->prio++;
+    p->slice = 0;
+    return 1;
+  }
+  return rqhigher(cpu, p->prio);
+}
+
+// Stride scheduling.  Each tick a process runs advances its pass
+// by its stride, STRIDE1/tickets, and the queue is kept sorted so
+// that the process with the smallest pass runs next; over time
+// each process gets CPU in proportion to its tickets.  A process
+// joining a queue starts no earlier than the queue's current pass,
+// so sleeping does not bank CPU time.  Passes wrap, so compare
+// them by signed difference.
+#define STRIDE1 (1 << 20)
+
+static void
+strideenqueue(struct runq *rq, struct proc *p)
+{
+  struct proc **pp;
+
+  if((int)(p->pass - rq->pass) < 0)
+    p->pass = rq->pass;
+  for(pp = &rq->head[0]; *pp; pp = &(*pp)->rqnext)
+    if((int)((*pp)->pass - p->pass) > 0)
+      break;
+  p->rqnext = *pp;
+  *pp = p;
+  if(p->rqnext == 0)
+    rq->tail[0] = p;
+  rq->n++;
+}
+
+static struct proc*
+stridedequeue(struct runq *rq)
+{
+  struct proc *p;
+
+  if((p = rqtake(rq)) != 0)
+    rq->pass = p->pass;
+  return p;
+}
+
+static int
+stridetick(struct proc *p, int cpu)
+{
+  p->pass += p->stride;
+  return runqs[cpu].n > 0;
+}
+
+static struct schedpolicy policies[] = {
+[SCHED_RR]      { "rr",     rrenqueue,     rqtake,        rrtick },
+[SCHED_MLFQ]    { "mlfq",   mlfqenqueue,   rqtake,        mlfqtick },
+[SCHED_STRIDE]  { "stride", strideenqueue, stridedequeue, stridetick },
+};
+
+static struct schedpolicy *policy = &policies[SCHEDPOLICY];
+
+// Queue p on cpu's run queue.
+static void
+rqpush(int cpu, struct proc *p)
+{
+  struct runq *rq = &runqs[cpu];
+
+  acquire(&rq->lock);
+  policy->enqueue(rq, p);
+  release(&rq->lock);
+}
+
+// Remove and return the process that should run next from
+// cpu's run queue, or 0 if the queue is empty.
+static struct proc*
+rqpop(int cpu)
+{
+  struct runq *rq = &runqs[cpu];
+  struct proc *p;
+
+  acquire(&rq->lock);
+  p = policy->dequeue(rq);
+  release(&rq->lock);
+  return p;
+}
+
+// Called by an idle CPU: take a process from the CPU with the
+// longest run queue.  The lengths are read without locks; a stale
+// value only means we pick a worse victim or find it empty.
+static struct proc*
+steal(int self)
+{
+  int i, victim, max;
+
+  victim = -1;
+  max = 0;
+  for(i = 0; i < ncpu; i++){
+    if(i != self && runqs[i].n > max){
+      max = runqs[i].n;
+      victim = i;
+    }
+  }
+  if(victim < 0)
+    return 0;
+  return rqpop(victim);
+}
+
+// Mark p RUNNABLE and queue it on the run queue of the CPU it
+// last ran on, which is most likely to still have its state cached.
+// p->lock must be held.
+static void
+setrunnable(struct proc *p)
+{
+  p->state = RUNNABLE;
+  rqpush(p->cpu, p);
+}
+
+// Make sure some CPU notices work just queued on cpu's run queue:
+// wake cpu itself if it is halted in idle(), or else any other
+// halted CPU, which will steal the work.  The interrupted CPU
+// rechecks the queues on its own, so never send to ourselves.
+static void
+kick(int cpu)
+{
+  int i, self;
+
+  self = cpuid();
+  if(cpus[cpu].idle){
+    if(cpu != self)
+      lapicipi(cpus[cpu].apicid, T_IRQ0 + IRQ_RESCHED);
+    return;
+  }
+  for(i = 0; i < ncpu; i++){
+    if(i != self && cpus[i].idle){
+      lapicipi(cpus[i].apicid, T_IRQ0 + IRQ_RESCHED);
+      return;
+    }
+  }
+}
+
+// Halt this CPU until an interrupt arrives, unless some run
+// queue has work.  c->idle is set (with a full barrier) before
+// the queues are checked, and rqpush() updates n before kick()
+// reads c->idle, so a process queued after the check always
+// finds c->idle set and interrupts the hlt.
+//
+// In tickless mode the timer is armed only for the next kernel timer
+// deadline, if any, while halted, and goes back to one-tick
+// deadlines once the CPU has something to do.
+static void
+idle(struct cpu *c)
+{
+  int i;
+  uint t0;
+
+  cli();
+  tickupdate();
+  xchg(&c->idle, 1);
+  for(i = 0; i < ncpu; i++)
+    if(runqs[i].n > 0)
+      break;
+  if(i == ncpu){
+    t0 = ticks;
+    if(TICKLESS)
+      lapictimer(ticknextwake());
+    stihlt();
+    cli();
+    c->idle = 0;
+    if(TICKLESS)
+      lapictimer(1);
+    tickupdate();
+    c->idleticks += ticks - t0;
+  }
+  c->idle = 0;
+}
+
+// Unlink sleeping process p from its wait channel bucket.
+// The bucket's lock must be held.
+static void
+sleepqremove(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &sleepq[SLEEPHASH(p->chan)].head; *pp; pp = &(*pp)->slnext){
+    if(*pp == p){
+      *pp = p->slnext;
+      p->slnext = 0;
+      return;
+    }
+  }
+  panic("sleepqremove");
 }
 
 // Must be called with interrupts disabled
@@ -68,11 +407,65 @@ myproc(void) {
   return p;
 }
 
+// Alarm timer function: note that p's handler is due, to be
+// called on p's next timer interrupt in user space, and
+// re-arm for the next period.  Called with tickslock held.
+static void
+alarmexpire(void *arg)
+{
+  struct proc *p = arg;
+
+  p->alarmpending = 1;
+  timeradd(&p->alarmtimer, p->alarmtimer.expires + p->alarmticks);
+}
+
+// Find the process with the given pid.  pidlock must be held,
+// and keeps the process from being freed until it is released.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  for(p = pidhash[PIDHASH(pid)]; p; p = p->hashnext)
+    if(p->pid == pid)
+      return p;
+  return 0;
+}
+
+// Take p off the pid hash table and free it along with its
+// kernel stack and page table.  Nobody else may be using p.
+static void
+freeproc(struct proc *p)
+{
+  struct proc **pp;
+
+  acquire(&pidlock);
+  for(pp = &pidhash[PIDHASH(p->pid)]; *pp != p; pp = &(*pp)->hashnext)
+    ;
+  *pp = p->hashnext;
+  if(swaphand == p)
+    swaphand = p->allnext;
+  if(p->allprev)
+    p->allprev->allnext = p->allnext;
+  else
+    allprocs = p->allnext;
+  if(p->allnext)
+    p->allnext->allprev = p->allprev;
+  else
+    allprocstail = p->allprev;
+  release(&pidlock);
+
+  if(p->kstack)
+    kfree(p->kstack);
+  if(p->pgdir)
+    freevm(p->pgdir);
+  kcachefree(proccache, p);
+}
+
 //PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
-// If found, change state to EMBRYO and initialize
-// state required to run in the kernel.
-// Otherwise return 0.
+// Allocate a new proc, change its state to EMBRYO
+// and initialize state required to run in the kernel.
+// Return 0 if out of memory.
 
 /* 
  * allocproc is to allocate a slot(struct proc) in the process table
@@ -92,30 +485,34 @@ allocproc(void)
 {
   struct proc *p;
   char *sp;
-  /*获取锁*/
-  acquire(&ptable.lock);
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
-  /*释放锁*/
-  release(&ptable.lock);
-  return 0;
 
   // ///////////////////
-  // 在进程表里找到一个进程
+  // 从proc cache分配一个进程
   // ///////////////////
-
-found:
+  if((p = kcachealloc(proccache)) == 0)
+    return 0;
+  memset(p, 0, sizeof(*p));
+  initlock(&p->lock, "proc");
   p->state = EMBRYO; /*EMBRYO:萌芽*/
+  p->tickets = DEFTICKETS;
+  p->stride = STRIDE1 / DEFTICKETS;
+  timerinit(&p->alarmtimer, alarmexpire, p);
+
+  acquire(&pidlock);
   p->pid = nextpid++;
-  //p->tick_counts = 0;
-  //p->alarmticks = -1;
-  release(&ptable.lock);
+  p->hashnext = pidhash[PIDHASH(p->pid)];
+  pidhash[PIDHASH(p->pid)] = p;
+  p->allprev = allprocstail;
+  if(allprocstail)
+    allprocstail->allnext = p;
+  else
+    allprocs = p;
+  allprocstail = p;
+  release(&pidlock);
 
   // Allocate kernel stack.
-  if((p->kstack = kalloc()) == 0){ /*allocate a kernel stack for the process's kernel thread*/
-    p->state = UNUSED;
+  if((p->kstack = kallocswap(0)) == 0){ /*allocate a kernel stack for the process's kernel thread*/
+    freeproc(p);
     return 0;
   }
 
@@ -214,11 +611,13 @@ userinit(void) /*这个函数只调用一次, 创建的init process是所有进
   // run this process. the acquire forces the above
   // writes to be visible, and the lock is also needed
   // because the assignment might not be atomic.
-  acquire(&ptable.lock);
+  acquire(&p->lock);
 
-  p->state = RUNNABLE; /*RUNNABLE state marks it available for scheduling*/
+  p->cpu = cpuid();
+  setrunnable(p); /*RUNNABLE state marks it available for scheduling*/
+  kick(p->cpu);
 
-  release(&ptable.lock);
+  release(&p->lock);
 }
 
 // Grow current process's memory by n bytes.
@@ -233,15 +632,32 @@ int
 growproc(int n)
 {
   uint sz;
+  struct seg *s;
   struct proc *curproc = myproc();
 
   sz = curproc->sz; /*proc->sz is the process's current size*/
-  if(n > 0){
+  // The heap may not grow into an mmap() region.
+  if(n > 0 && sz + n > sz && vmaoverlap(curproc, sz, PGROUNDUP(sz + n)))
+    return -1;
+  if(n > 0 && LAZYSBRK){
+    // Pages are allocated and zeroed on first touch (see uvmfault).
+    if(sz + n < sz || sz + n >= KERNBASE)
+      return -1;
+    sz += n;
+  } else if(n > 0){
     if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
   } else if(n < 0){
     if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
+    // Program pages given back are zeroed heap if the heap
+    // grows over them again, not read in from the file.
+    for(s = curproc->segs; s < &curproc->segs[curproc->nseg]; s++){
+      if(s->va + s->memsz > PGROUNDUP(sz))
+        s->memsz = s->va < PGROUNDUP(sz) ? PGROUNDUP(sz) - s->va : 0;
+      if(s->filesz > s->memsz)
+        s->filesz = s->memsz;
+    }
   }
   curproc->sz = sz;
   switchuvm(curproc); /*sets %*/
@@ -263,14 +679,11 @@ fork(void)
     return -1;
   }
   // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
-    kfree(np->kstack);
-    np->kstack = 0;
-    np->state = UNUSED;
+  if((np->pgdir = copyuvm(curproc)) == 0){
+    freeproc(np);
     return -1;
   }
   np->sz = curproc->sz;
-  np->parent = curproc;
   /*让子进程和父进程的trapframe相同，这样子进程回到用户空间后，才会和父进程回到的地方一样*/
   *np->tf = *curproc->tf; 
   // Clear %eax so that fork returns 0 in the child.
@@ -281,11 +694,33 @@ fork(void)
       np->ofile[i] = filedup(curproc->ofile[i]);
 
   np->cwd = idup(curproc->cwd);
+  if(curproc->exe)
+    np->exe = idup(curproc->exe);
+  memmove(np->segs, curproc->segs, sizeof(curproc->segs));
+  np->nseg = curproc->nseg;
+  np->superpages = curproc->superpages;
+  vmadup(np);
+  // The child starts at the highest level its parent may use.
+  np->nice = curproc->nice;
+  np->prio = np->nice;
+  np->tickets = curproc->tickets;
+  np->stride = curproc->stride;
+  np->pass = curproc->pass;
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
   pid = np->pid;
-  acquire(&ptable.lock);
-  np->state = RUNNABLE;
-  release(&ptable.lock);
+
+  acquire(&parentlock);
+  np->parent = curproc;
+  np->sibling = curproc->children;
+  curproc->children = np;
+  release(&parentlock);
+
+  acquire(&np->lock);
+  // Start the child on this CPU; an idle CPU will steal it.
+  np->cpu = cpuid();
+  setrunnable(np);
+  kick(np->cpu);
+  release(&np->lock);
   return pid;
 }
 
@@ -310,27 +745,46 @@ exit(void)
     }
   }
 
+  vmafree(curproc);
+
   begin_op();
   iput(curproc->cwd);
+  if(curproc->exe)
+    iput(curproc->exe);
   end_op();
   curproc->cwd = 0;
+  curproc->exe = 0;
 
-  acquire(&ptable.lock);
+  acquire(&tickslock);
+  timerdel(&curproc->alarmtimer);
+  release(&tickslock);
 
-  // Parent might be sleeping in wait().
-  wakeup1(curproc->parent);
+  // Holding parentlock keeps our parent from looking at us in
+  // wait() until we are a ZOMBIE, so the wakeup cannot be lost.
+  acquire(&parentlock);
 
-  // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->parent == curproc){
+  // Pass abandoned children to init.  One of them may be a
+  // ZOMBIE already, so init must look.
+  if(curproc->children){
+    for(p = curproc->children; ; p = p->sibling){
       p->parent = initproc;
-      if(p->state == ZOMBIE)
-        wakeup1(initproc);
+      if(p->sibling == 0)
+        break;
     }
+    p->sibling = initproc->children;
+    initproc->children = curproc->children;
+    curproc->children = 0;
+    wakeup(initproc);
   }
 
-  // Jump into the scheduler, never to return.
+  // Parent might be sleeping in wait().
+  wakeup(curproc->parent);
+
+  acquire(&curproc->lock);
   curproc->state = ZOMBIE;
+  release(&parentlock);
+
+  // Jump into the scheduler, never to return.
   sched();
   panic("zombie exit");
 }
@@ -340,42 +794,43 @@ exit(void)
 int
 wait(void)
 {
-  struct proc *p;
-  int havekids, pid;
+  struct proc *p, **pp;
+  int pid;
   struct proc *curproc = myproc();
   
-  acquire(&ptable.lock);
+  acquire(&parentlock);
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
-      havekids = 1;
+    // Scan through our children looking for exited ones.
+    for(pp = &curproc->children; (p = *pp) != 0; pp = &p->sibling){
+      // A ZOMBIE's lock is held until it is off its CPU,
+      // so once we have it the kernel stack is free to go.
+      acquire(&p->lock);
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
-        kfree(p->kstack);
-        p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
+        curproc->cutime += p->utime + p->cutime;
+        curproc->cstime += p->stime + p->cstime;
+        curproc->cnvcsw += p->nvcsw + p->cnvcsw;
+        curproc->cnivcsw += p->nivcsw + p->cnivcsw;
+        curproc->cnfault += p->nfault + p->cnfault;
         p->state = UNUSED;
-        release(&ptable.lock);
+        release(&p->lock);
+        *pp = p->sibling;
+        freeproc(p);
+        release(&parentlock);
         return pid;
       }
+      release(&p->lock);
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || curproc->killed){
-      release(&ptable.lock);
+    if(curproc->children == 0 || curproc->killed){
+      release(&parentlock);
       return -1;
     }
 
-    // Wait for children to exit.  (See wakeup1 call in proc_exit.)
-    sleep(curproc, &ptable.lock);  //DOC: wait-sleep
+    // Wait for children to exit.  (See wakeup call in exit.)
+    sleep(curproc, &parentlock);  //DOC: wait-sleep
   }
 }
 
@@ -383,7 +838,9 @@ wait(void)
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run
+//  - take a process from this CPU's run queue, or
+//    steal one from another CPU's queue if ours is empty,
+//    or halt if there is nothing to run anywhere
 //  - swtch to start running that process
 //  - eventually that process transfers control
 //      via swtch back to the scheduler.
@@ -392,52 +849,67 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int id = cpuid();
   c->proc = 0;
   
   for(;;){
     // Enable interrupts on this processor.
     sti();
 
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE) 
+    // Only the run queues are touched while looking for work.
+    // With nothing to run, halt until fork() or wakeup() kicks us.
+    // The last process's address space stays loaded until we
+    // know what runs next, so going straight to another process
+    // costs one %cr3 load, and the kernel's global TLB entries
+    // survive it.  Before halting, zero a page for kalloczero();
+    // the run queues are checked again between pages.
+    if((p = rqpop(id)) == 0 && (p = steal(id)) == 0){
+      if(c->pgdir != kpgdir)
+        switchkvm();
+      if(kzeroidle())
         continue;
-
-      // ////////////////////////////////
-      // 运行刚找到的进程状态为RUNNABLE的进程
-      // ////////////////////////////////
-
-      // Switch to chosen process.  It is the process's job
-      // to release ptable.lock and then reacquire it
-      // before jumping back to us.
-
-      // 将找到的进程设置为CPU当前执行的进程
-      c->proc = p; 
-
-      // 这里主要是为了切换到目标进程到页目录
-      // 在内核执行的时候切换页表是可以的, 因为在setupkvm()中将所有页表的内核映射都设置相同
-      switchuvm(p); /*tell the hardware to start using the target process's page table*/
-      p->state = RUNNING;
-
-      /* 
-       * this perform a context switch to the target process's kernel thread
-       * the current context is not a process but rather a special per-cpu scheduler context,
-       * so scheduler tells swtch() to save the current hardware registers in 
-       * per-cpu storage(cpu->scheduler) rather than in any process's kernel thread context
-       */ 
-      swtch(&(c->scheduler), p->context); 
-      switchkvm();
-
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
+      idle(c);
+      continue;
     }
-    release(&ptable.lock);
+
+    // ////////////////////////////////
+    // 运行刚找到的进程状态为RUNNABLE的进程
+    // ////////////////////////////////
+
+    // Switch to chosen process.  It is the process's job
+    // to release p->lock and then reacquire it
+    // before jumping back to us.  A process that just
+    // queued itself in yield() holds p->lock until it
+    // is off its CPU, so it cannot run in two places at once.
+    acquire(&p->lock);
+    if(p->state != RUNNABLE)
+      panic("scheduler: not runnable");
+
+    // 将找到的进程设置为CPU当前执行的进程
+    c->proc = p; 
+    p->cpu = id;
+
+    // 这里主要是为了切换到目标进程到页目录
+    // 在内核执行的时候切换页表是可以的, 因为在setupkvm()中将所有页表的内核映射都设置相同
+    switchuvm(p); /*tell the hardware to start using the target process's page table*/
+    p->state = RUNNING;
+
+    /* 
+     * this perform a context switch to the target process's kernel thread
+     * the current context is not a process but rather a special per-cpu scheduler context,
+     * so scheduler tells swtch() to save the current hardware registers in 
+     * per-cpu storage(cpu->scheduler) rather than in any process's kernel thread context
+     */ 
+    swtch(&(c->scheduler), p->context); 
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    c->proc = 0;
+    release(&p->lock);
   }
 }
 
-// Enter scheduler.  Must hold only ptable.lock
+// Enter scheduler.  Must hold only p->lock
 // and have changed proc->state. Saves and restores
 // intena because intena is a property of this
 // kernel thread, not this CPU. It should
@@ -450,8 +922,8 @@ sched(void)
   int intena;
   struct proc *p = myproc();
 
-  if(!holding(&ptable.lock))
-    panic("sched ptable.lock");
+  if(!holding(&p->lock))
+    panic("sched p->lock");
   if(mycpu()->ncli != 1)
     panic("sched locks");
   if(p->state == RUNNING)
@@ -463,14 +935,154 @@ sched(void)
   mycpu()->intena = intena;
 }
 
+// Called on each clock tick with the current process RUNNING.
+// Charge the tick to the process under the active policy and
+// give up the CPU if the policy says its time slice is over.
+void
+schedtick(void)
+{
+  struct proc *p = myproc();
+  int id;
+
+  pushcli();
+  id = cpuid();
+  popcli();
+  if(policy->tick(p, id))
+    yield();
+}
+
+// Take every process off rq, preserving the order they would
+// have run in, and return them linked through rqnext.
+// rq->lock must be held.
+static struct proc*
+rqdrain(struct runq *rq)
+{
+  struct proc *p, *list, **tailp;
+
+  list = 0;
+  tailp = &list;
+  while((p = rqtake(rq)) != 0){
+    *tailp = p;
+    tailp = &p->rqnext;
+  }
+  return list;
+}
+
+// Move every process back to the highest level it is allowed,
+// so that CPU-bound processes that sank to the bottom are not
+// starved by a steady stream of interactive ones.  Called by
+// the timer interrupt every BOOSTTICKS ticks.
+void
+boost(void)
+{
+  struct proc *p, *q;
+  struct runq *rq;
+  int i;
+
+  if(policy != &policies[SCHED_MLFQ])
+    return;
+  acquire(&pidlock);
+  for(i = 0; i < NPIDHASH; i++){
+    for(p = pidhash[i]; p; p = p->hashnext){
+      acquire(&p->lock);
+      p->prio = p->nice;
+      p->slice = 0;
+      release(&p->lock);
+    }
+  }
+  release(&pidlock);
+  // Requeue the waiting processes at their new levels.
+  for(rq = runqs; rq < &runqs[ncpu]; rq++){
+    acquire(&rq->lock);
+    for(p = rqdrain(rq); p; p = q){
+      q = p->rqnext;
+      policy->enqueue(rq, p);
+    }
+    release(&rq->lock);
+  }
+}
+
+// Switch to scheduling policy which (see sched.h) and requeue
+// every waiting process under it.  Returns the previous policy.
+// All run queues stay locked until the switch is done, so every
+// queue is served under a single policy at any time.
+int
+setsched(int which)
+{
+  struct proc *p, *q, *list[NCPU];
+  int i, old;
+
+  if(which < 0 || which >= NELEM(policies))
+    return -1;
+  for(i = 0; i < ncpu; i++){
+    acquire(&runqs[i].lock);
+    list[i] = rqdrain(&runqs[i]);
+  }
+  old = policy - policies;
+  policy = &policies[which];
+  for(i = 0; i < ncpu; i++){
+    for(p = list[i]; p; p = q){
+      q = p->rqnext;
+      policy->enqueue(&runqs[i], p);
+    }
+    release(&runqs[i].lock);
+  }
+  return old;
+}
+
+// Give the current process n tickets for stride scheduling.
+int
+settickets(int n)
+{
+  struct proc *p = myproc();
+
+  if(n < 1 || n > STRIDE1)
+    return -1;
+  acquire(&p->lock);
+  p->tickets = n;
+  p->stride = STRIDE1 / n;
+  release(&p->lock);
+  return 0;
+}
+
+// Set the highest MLFQ level process pid may run at.  A process
+// currently above that level drops to it right away.
+int
+setpriority(int pid, int prio)
+{
+  struct proc *p;
+
+  if(prio < 0 || prio >= NPRIO)
+    return -1;
+  acquire(&pidlock);
+  if((p = findproc(pid)) == 0){
+    release(&pidlock);
+    return -1;
+  }
+  acquire(&p->lock);
+  p->nice = prio;
+  // A queued process keeps its place; the new level
+  // applies the next time it is queued.
+  if(p->prio < prio){
+    p->prio = prio;
+    p->slice = 0;
+  }
+  release(&p->lock);
+  release(&pidlock);
+  return 0;
+}
+
 // Give up the CPU for one scheduling round.
 void
 yield(void)
 {
-  acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE;
+  struct proc *p = myproc();
+
+  acquire(&p->lock);  //DOC: yieldlock
+  p->nivcsw++;
+  setrunnable(p);
   sched();
-  release(&ptable.lock);
+  release(&p->lock);
 }
 
 // A fork child's very first scheduling by scheduler()
@@ -485,8 +1097,8 @@ void
 forkret(void)
 {
   static int first = 1;
-  // Still holding ptable.lock from scheduler.
-  release(&ptable.lock);
+  // Still holding p->lock from scheduler.
+  release(&myproc()->lock);
 
   if (first) {
     // Some initialization functions must be run in the context
@@ -506,6 +1118,7 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *sq = &sleepq[SLEEPHASH(chan)];
   
   if(p == 0)
     panic("sleep");
@@ -513,19 +1126,25 @@ sleep(void *chan, struct spinlock *lk)
   if(lk == 0)
     panic("sleep without lk");
 
-  // Must acquire ptable.lock in order to
+  // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold ptable.lock, we can be
+  // Once we hold chan's sleep queue lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup runs with ptable.lock locked),
+  // (wakeup runs with that lock held),
   // so it's okay to release lk.
-  if(lk != &ptable.lock){  //DOC: sleeplock0
-    acquire(&ptable.lock);  //DOC: sleeplock1
-    release(lk);
-  }
+  acquire(&sq->lock);  //DOC: sleeplock1
+  acquire(&p->lock);
+  release(lk);
+
   // Go to sleep.
+  p->nvcsw++;
   p->chan = chan;
   p->state = SLEEPING;
+  p->slnext = sq->head;
+  sq->head = p;
+  // A waker that finds us now waits on p->lock
+  // until we are off this CPU.
+  release(&sq->lock);
 
   sched();
 
@@ -533,32 +1152,32 @@ sleep(void *chan, struct spinlock *lk)
   p->chan = 0;
 
   // Reacquire original lock.
-  if(lk != &ptable.lock){  //DOC: sleeplock2
-    release(&ptable.lock);
-    acquire(lk);
-  }
+  release(&p->lock);
+  acquire(lk);
 }
 
 //PAGEBREAK!
-// Wake up all processes sleeping on chan.
-// The ptable lock must be held.
-static void
-wakeup1(void *chan)
-{
-  struct proc *p;
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
-      p->state = RUNNABLE;
-}
-
 // Wake up all processes sleeping on chan.
 void
 wakeup(void *chan)
 {
-  acquire(&ptable.lock);
-  wakeup1(chan);
-  release(&ptable.lock);
+  struct sleepq *sq = &sleepq[SLEEPHASH(chan)];
+  struct proc *p, **pp;
+
+  acquire(&sq->lock);
+  pp = &sq->head;
+  while((p = *pp) != 0){
+    if(p->chan == chan){
+      *pp = p->slnext;
+      p->slnext = 0;
+      acquire(&p->lock);
+      setrunnable(p);
+      kick(p->cpu);
+      release(&p->lock);
+    } else
+      pp = &p->slnext;
+  }
+  release(&sq->lock);
 }
 
 // Kill the process with the given pid.
@@ -566,22 +1185,97 @@ wakeup(void *chan)
 // to user space (see trap in trap.c).
 int
 kill(int pid)
+{
+  struct proc *p;
+  struct sleepq *sq;
+  void *chan;
+
+  acquire(&pidlock);
+  if((p = findproc(pid)) == 0){
+    release(&pidlock);
+    return -1;
+  }
+  acquire(&p->lock);
+  p->killed = 1;
+  chan = p->state == SLEEPING ? p->chan : 0;
+  release(&p->lock);
+  if(chan){
+    // Wake process from sleep if necessary.  The sleep
+    // queue lock comes first, so look again once we hold both.
+    sq = &sleepq[SLEEPHASH(chan)];
+    acquire(&sq->lock);
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan){
+      sleepqremove(p);
+      setrunnable(p);
+      kick(p->cpu);
+    }
+    release(&p->lock);
+    release(&sq->lock);
+  }
+  release(&pidlock);
+  return 0;
+}
+
+// Whether the swap clock may take p's pages; p->lock must be
+// held.  That is the current process or one that is off its CPU,
+// RUNNABLE or SLEEPING, so that nothing changes its page table
+// while p->lock is held, and only while the kernel is not using
+// its memory directly (p->upin).
+static int
+swappable(struct proc *p)
+{
+  return p->pgdir && !p->upin && (p == myproc() ||
+         p->state == RUNNABLE || p->state == SLEEPING);
+}
+
+// For the swap clock (see swap.c): return the next process in
+// pid order whose pages may be swapped out, with p->lock held,
+// and move the hand past it.  At the end of the list, returns 0
+// and puts the hand back at the start.  pidlock is held only
+// while looking at one process, not for the whole walk.
+struct proc*
+swapnext(void)
 {
   struct proc *p;
 
-  acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
-        p->state = RUNNABLE;
-      release(&ptable.lock);
+  for(;;){
+    acquire(&pidlock);
+    if((p = swaphand) == 0){
+      swaphand = allprocs;
+      release(&pidlock);
       return 0;
     }
+    swaphand = p->allnext;
+    // Once it is known not to be a ZOMBIE, p->lock alone keeps
+    // p from being freed.
+    acquire(&p->lock);
+    if(swappable(p)){
+      release(&pidlock);
+      return p;
+    }
+    release(&p->lock);
+    release(&pidlock);
+  }
+}
+
+// Return the process with the given pid, with p->lock held, if
+// its pages may still be swapped out, or 0.
+struct proc*
+swapproc(int pid)
+{
+  struct proc *p;
+
+  acquire(&pidlock);
+  if((p = findproc(pid)) != 0){
+    acquire(&p->lock);
+    if(!swappable(p)){
+      release(&p->lock);
+      p = 0;
+    }
   }
-  release(&ptable.lock);
-  return -1;
+  release(&pidlock);
+  return p;
 }
 
 //PAGEBREAK: 36
@@ -599,24 +1293,28 @@ procdump(void)
   [RUNNING]   "run   ",
   [ZOMBIE]    "zombie"
   };
-  int i;
+  int h, i;
   struct proc *p;
   char *state;
   uint pc[10];
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state == UNUSED)
-      continue;
-    if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
-      state = states[p->state];
-    else
-      state = "???";
-    cprintf("%d %s %s", p->pid, state, p->name);
-    if(p->state == SLEEPING){
-      getcallerpcs((uint*)p->context->ebp+2, pc);
-      for(i=0; i<10 && pc[i] != 0; i++)
-        cprintf(" %p", pc[i]);
+  for(h = 0; h < NPIDHASH; h++){
+    for(p = pidhash[h]; p; p = p->hashnext){
+      if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
+        state = states[p->state];
+      else
+        state = "???";
+      cprintf("%d %s %s prio %d usr %d sys %d vcsw %d ivcsw %d flt %d",
+              p->pid, state, p->name, p->prio, p->utime, p->stime,
+              p->nvcsw, p->nivcsw, p->nfault);
+      if(p->state == SLEEPING){
+        getcallerpcs((uint*)p->context->ebp+2, pc);
+        for(i=0; i<10 && pc[i] != 0; i++)
+          cprintf(" %p", pc[i]);
+      }
+      cprintf("\n");
     }
-    cprintf("\n");
   }
+  for(i = 0; i < ncpu; i++)
+    cprintf("cpu%d: idle %d ticks\n", i, cpus[i].idleticks);
 }
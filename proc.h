@@ -8,11 +8,45 @@ struct cpu {
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  volatile uint idle;          // Halted in scheduler() waiting for work?
+  uint idleticks;              // Ticks spent halted
+  pde_t *volatile pgdir;       // Page directory in %cr3
 };
 
 extern struct cpu cpus[NCPU];
 extern int ncpu;
 
+// A segment of the program image, paged in from the executable
+// the first time it is touched (see exec.c and uvmfault()).
+struct seg {
+  uint va;                     // Start, page aligned
+  uint memsz;                  // Size in memory
+  uint off;                    // File offset of va
+  uint filesz;                 // Bytes from the file; the rest is zero
+  uint perm;                   // PTE_W if writable, else shared
+};
+
+// A region mapped with mmap() or shmat(), above the heap (see
+// mmap.c).
+struct vma {
+  uint start;                  // Page aligned
+  uint end;                    // Page aligned; 0 if the slot is free
+  int prot;                    // PROT_READ, PROT_WRITE
+  struct file *f;              // Mapped file, or 0
+  struct shm *shm;             // Shared segment (see shm.c), or 0
+  uint off;                    // File offset of start
+};
+
+// A kernel timer, kept on the timer wheel in timer.c.
+struct timer {
+  uint expires;                // Tick at which fn is called
+  void (*fn)(void*);           // Called with tickslock held
+  void *arg;
+  int pending;                 // On the wheel?
+  struct timer *next;          // Next timer in the same wheel slot
+  struct timer **pprev;        // Link that points to this timer
+};
+
 //PAGEBREAK: 17
 // Saved registers for kernel context switches.
 // Don't need to save all the segment registers (%cs, etc),
@@ -39,6 +73,7 @@ enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
  * which it gathers into a struct proc
  */
 struct proc {
+  struct spinlock lock;               // Protects state, chan, killed, pid
   uint sz;                            // Size of process memory (bytes)
   
   /*xv6 cause the process's hardware to use the p->pgdir*/
@@ -47,19 +82,50 @@ struct proc {
   char *kstack; /*important*/         // Bottom of kernel stack for this process(important)
   enum procstate state; /*important*/ // Process state(important)
   int pid;                            // Process ID
-  struct proc *parent;                // Parent process
+  struct proc *hashnext;              // Next process in pid's hash bucket
+  struct proc *allnext;               // Next and previous processes
+  struct proc *allprev;               //   in pid order (pidlock)
+  struct proc *parent;                // Parent process (parentlock)
+  struct proc *children;              // First child (parentlock)
+  struct proc *sibling;               // Next child of parent (parentlock)
   struct trapframe *tf;               // Trap frame for current syscall
   struct context *context;            // swtch() here to run process
   void *chan;                         // If non-zero, sleeping on chan
+  struct proc *slnext;                // Next sleeper in chan's hash bucket
   int killed;                         // If non-zero, have been killed
   struct file *ofile[NOFILE];         // Open files
   struct inode *cwd;                  // Current directory
+  struct inode *exe;                  // Executable the segs come from
+  struct seg segs[NSEG];              // Program image, paged in on demand
+  int nseg;
+  struct vma vmas[NVMA];              // mmap() regions
+  int upin;                           // Kernel uses user memory directly; no swapping
   char name[16];                      // Process name (debugging)
+  int cpu;                            // CPU whose run queue holds p (last ran on)
+  struct proc *rqnext;                // Next RUNNABLE process on that run queue
+  int prio;                           // MLFQ level, 0 (highest) .. NPRIO-1
+  int nice;                           // Highest level p may be boosted to
+  int slice;                          // Ticks used at the current level
+  int tickets;                        // Stride scheduling share
+  uint stride;                        // STRIDE1 / tickets
+  uint pass;                          // Stride virtual time
+  uint utime;                         // Ticks spent in user mode
+  uint stime;                         // Ticks spent in the kernel
+  uint nvcsw;                         // Voluntary context switches
+  uint nivcsw;                        // Involuntary context switches
+  uint nfault;                        // Page faults
+  int superpages;                     // Back big heap regions with 4 MB pages
+  uint cutime;                        // Totals for waited-for children
+  uint cstime;
+  uint cnvcsw;
+  uint cnivcsw;
+  uint cnfault;
 
   // add for alarmtest.c
-  int alarmticks;
+  int alarmticks;                     // Alarm period, 0 if none
   void (*alarmhandler)();
-  int tick_counts;
+  struct timer alarmtimer;            // Fires every alarmticks ticks
+  uint alarmpending;                  // Alarm fired, handler not yet called
 };
 
 // Process memory is laid out contiguously, low addresses first:
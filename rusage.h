@@ -0,0 +1,10 @@
+#define RUSAGE_SELF     0   // The calling process
+#define RUSAGE_CHILDREN (-1)  // Its children that have been waited for
+
+struct rusage {
+  uint utime;   // Ticks spent in user mode
+  uint stime;   // Ticks spent in the kernel
+  uint nvcsw;   // Voluntary context switches (blocked in sleep)
+  uint nivcsw;  // Involuntary context switches (preempted)
+  uint nfault;  // Page faults
+};
@@ -0,0 +1,10 @@
+// Scheduling policies, for setsched().
+#define SCHED_RR      0  // round robin, one tick time slices
+#define SCHED_MLFQ    1  // multi-level feedback queue
+#define SCHED_STRIDE  2  // proportional share, see settickets()
+
+// Policy the kernel boots with; override with
+// make SCHEDPOLICY=RR, MLFQ or STRIDE.
+#ifndef SCHEDPOLICY
+#define SCHEDPOLICY   SCHED_MLFQ
+#endif
@@ -0,0 +1,91 @@
+// Scheduler scalability benchmark.
+// For k = 1..N, run k independent pairs of processes that bounce a
+// byte back and forth over two pipes, and report the aggregate
+// context switch rate.  Every round trip blocks each side once, so
+// it costs at least two context switches.  With CPUS >= N in the
+// Makefile, k pairs keep about k CPUs busy.
+//
+// usage: schedbench [N]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define RUNTIME 200   // length of each run, in ticks
+
+// Drive one ping-pong pair until deadline and write the number
+// of completed round trips to fd.
+void
+pair(uint deadline, int fd)
+{
+  int ping[2], pong[2];
+  int n;
+  char c;
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf(2, "schedbench: pipe failed\n");
+    exit();
+  }
+  if(fork() == 0){
+    close(ping[1]);
+    close(pong[0]);
+    while(read(ping[0], &c, 1) == 1)
+      write(pong[1], &c, 1);
+    exit();
+  }
+  close(ping[0]);
+  close(pong[1]);
+
+  c = 'x';
+  for(n = 0; ; n++){
+    if((n % 64) == 0 && uptime() >= deadline)
+      break;
+    write(ping[1], &c, 1);
+    if(read(pong[0], &c, 1) != 1)
+      break;
+  }
+  close(ping[1]);  // echo child sees EOF and exits
+  close(pong[0]);
+  wait();
+  write(fd, &n, sizeof(n));
+  exit();
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fds[2];
+  int i, k, maxk, n, total;
+  uint start;
+
+  maxk = NCPU;
+  if(argc > 1)
+    maxk = atoi(argv[1]);
+
+  printf(1, "schedbench: %d ticks per run\n", RUNTIME);
+  for(k = 1; k <= maxk; k++){
+    if(pipe(fds) < 0){
+      printf(2, "schedbench: pipe failed\n");
+      exit();
+    }
+    start = uptime();
+    for(i = 0; i < k; i++){
+      if(fork() == 0){
+        close(fds[0]);
+        pair(start + RUNTIME, fds[1]);
+      }
+    }
+    close(fds[1]);
+    total = 0;
+    for(i = 0; i < k; i++){
+      if(read(fds[0], &n, sizeof(n)) == sizeof(n))
+        total += n;
+    }
+    close(fds[0]);
+    for(i = 0; i < k; i++)
+      wait();
+    printf(1, "%d pairs: %d switches/sec\n", k, 2 * total * HZ / RUNTIME);
+  }
+  exit();
+}
@@ -0,0 +1,172 @@
+// Shared memory segments.
+//
+// shmget() finds or creates a segment by key, shmat() maps the
+// whole segment into the calling process as a vma (see mmap.c),
+// and shmdt() unmaps it.  Every process that attaches a segment
+// maps the same physical pages, so writes by one are seen by
+// all.  The pages are allocated zeroed when first touched.
+//
+// Each attachment, including one inherited through fork(),
+// holds a reference to the segment; the segment and its pages
+// are freed when the last one is dropped.  Each mapping of a
+// page also holds a reference to the page itself (see kincref),
+// so a page stays until it is unmapped everywhere, even if the
+// segment goes first.  A segment that is created but never
+// attached keeps its slot until it is.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "mman.h"
+
+struct shm {
+  int key;                     // 0 if the slot is free
+  int ref;                     // Attachments
+  uint npages;
+  char *pages[SHMPAGES];       // 0 until first touched
+};
+
+struct {
+  struct spinlock lock;
+  struct shm shm[NSHM];
+} shmtable;
+
+void
+shminit(void)
+{
+  initlock(&shmtable.lock, "shm");
+}
+
+// Return the id of the segment with key, creating it with room
+// for size bytes if there is none.  Returns -1 if the key is
+// bad, an existing segment is smaller than size, or the table
+// is full.
+int
+shmget(int key, uint size)
+{
+  struct shm *sh, *free;
+
+  if(key <= 0 || size == 0 || size > SHMPAGES*PGSIZE)
+    return -1;
+  acquire(&shmtable.lock);
+  free = 0;
+  for(sh = shmtable.shm; sh < &shmtable.shm[NSHM]; sh++){
+    if(sh->key == key){
+      release(&shmtable.lock);
+      if(size > sh->npages*PGSIZE)
+        return -1;
+      return sh - shmtable.shm;
+    }
+    if(sh->key == 0 && free == 0)
+      free = sh;
+  }
+  if(free == 0){
+    release(&shmtable.lock);
+    return -1;
+  }
+  free->key = key;
+  free->ref = 0;
+  free->npages = PGROUNDUP(size) / PGSIZE;
+  release(&shmtable.lock);
+  return free - shmtable.shm;
+}
+
+// Map segment id into the current process, readable and
+// writable.  Returns its address, or -1.
+int
+shmat(int id)
+{
+  struct shm *sh;
+  int addr;
+
+  if(id < 0 || id >= NSHM)
+    return -1;
+  sh = &shmtable.shm[id];
+  acquire(&shmtable.lock);
+  if(sh->key == 0){
+    release(&shmtable.lock);
+    return -1;
+  }
+  sh->ref++;
+  release(&shmtable.lock);
+  addr = mmap(0, sh, sh->npages*PGSIZE, PROT_READ|PROT_WRITE, 0);
+  if(addr < 0){
+    // Drop the reference without freeing the segment, which
+    // keeps its slot even if nothing has it attached.
+    acquire(&shmtable.lock);
+    sh->ref--;
+    release(&shmtable.lock);
+  } else
+    shmclose(sh);
+  return addr;
+}
+
+// Unmap the segment attached at addr from the current process.
+int
+shmdt(uint addr)
+{
+  struct vma *v;
+
+  if((v = vmalookup(myproc(), addr)) == 0 || v->shm == 0)
+    return -1;
+  return munmap(v->start, v->end - v->start);
+}
+
+// Add a reference to sh, for a new mapping of it.
+struct shm*
+shmdup(struct shm *sh)
+{
+  acquire(&shmtable.lock);
+  if(sh->ref < 1)
+    panic("shmdup");
+  sh->ref++;
+  release(&shmtable.lock);
+  return sh;
+}
+
+// Drop a reference to sh, freeing it if that was the last.
+void
+shmclose(struct shm *sh)
+{
+  int i;
+
+  acquire(&shmtable.lock);
+  if(sh->ref < 1)
+    panic("shmclose");
+  if(--sh->ref > 0){
+    release(&shmtable.lock);
+    return;
+  }
+  for(i = 0; i < sh->npages; i++)
+    if(sh->pages[i])
+      kfree(sh->pages[i]);
+  memset(sh, 0, sizeof(*sh));
+  release(&shmtable.lock);
+}
+
+// Return the page at byte offset off in sh, allocating it if
+// this is its first use, with a reference added for the
+// caller's mapping.  Returns 0 if out of memory.
+char*
+shmpage(struct shm *sh, uint off)
+{
+  char *mem;
+
+  acquire(&shmtable.lock);
+  if(off / PGSIZE >= sh->npages)
+    panic("shmpage");
+  if((mem = sh->pages[off / PGSIZE]) == 0){
+    if((mem = kalloczero()) == 0){
+      release(&shmtable.lock);
+      return 0;
+    }
+    sh->pages[off / PGSIZE] = mem;
+  }
+  kincref(mem);
+  release(&shmtable.lock);
+  return mem;
+}
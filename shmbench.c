@@ -0,0 +1,166 @@
+// Shared memory segment test and bandwidth benchmark.
+// Checks that a segment is shared across fork() and with a
+// process that attaches it by id, and that its pages are freed
+// on the last detach.  Then moves NBYTES from one process to
+// another through a pipe, and through a segment used as a
+// double buffer, with one byte on a pipe to hand each half
+// over, and reports the bandwidth of each.
+//
+// usage: shmbench
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "mman.h"
+
+#define PGSIZE  4096
+#define NPAGES  32                    // segment size in pages
+#define HALF    (NPAGES/2*PGSIZE)     // bytes per buffer half
+#define NBYTES  (8*1024*1024)         // bytes to move
+#define CHUNK   4096                  // bytes per pipe write
+
+char buf[CHUNK];
+
+void
+fail(char *what)
+{
+  printf(1, "shmbench: %s FAILED\n", what);
+  exit();
+}
+
+void
+sharetest(void)
+{
+  int id, i, before, pid;
+  char *p, *q;
+
+  printf(1, "shared segment\n");
+  if((id = shmget(1, NPAGES*PGSIZE)) < 0)
+    fail("shmget");
+  if(shmget(1, 2*NPAGES*PGSIZE) >= 0)
+    fail("shmget larger than segment");
+  if((p = shmat(id)) == (char*)-1)
+    fail("shmat");
+  for(i = 0; i < NPAGES*PGSIZE; i += PGSIZE)
+    if(p[i] != 0)
+      fail("zeroed");
+
+  // A child's writes are seen by its parent.
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0){
+    for(i = 0; i < NPAGES*PGSIZE; i++)
+      p[i] = i;
+    exit();
+  }
+  wait();
+  for(i = 0; i < NPAGES*PGSIZE; i++)
+    if(p[i] != (char)i)
+      fail("write by child");
+
+  // So are those of a process that attaches it by id.
+  pid = fork();
+  if(pid == 0){
+    shmdt(p);
+    if((q = shmat(shmget(1, PGSIZE))) == (char*)-1)
+      fail("shmat in child");
+    q[0] = 42;
+    shmdt(q);
+    exit();
+  }
+  wait();
+  if(p[0] != 42)
+    fail("write through second attach");
+
+  before = freemem();
+  if(shmdt(p) < 0)
+    fail("shmdt");
+  if(shmdt(p) >= 0)
+    fail("second shmdt");
+  if(freemem() - before < NPAGES)
+    fail("pages freed on last detach");
+  printf(1, "shared segment ok\n");
+}
+
+void
+pipebench(void)
+{
+  int fds[2], n, total;
+  uint start;
+
+  if(pipe(fds) < 0)
+    fail("pipe");
+  start = uptime();
+  if(fork() == 0){
+    close(fds[0]);
+    for(total = 0; total < NBYTES; total += CHUNK)
+      if(write(fds[1], buf, CHUNK) != CHUNK)
+        fail("pipe write");
+    exit();
+  }
+  close(fds[1]);
+  for(total = 0; (n = read(fds[0], buf, CHUNK)) > 0; total += n)
+    ;
+  wait();
+  close(fds[0]);
+  if(total != NBYTES)
+    fail("pipe bytes");
+  printf(1, "pipe: %d bytes in %d ticks\n", NBYTES, uptime() - start);
+}
+
+void
+shmbench(void)
+{
+  int id, full[2], empty[2], total, i;
+  uint start, sum;
+  char *p, c;
+
+  if((id = shmget(2, NPAGES*PGSIZE)) < 0 || (p = shmat(id)) == (char*)-1)
+    fail("shmat");
+  if(pipe(full) < 0 || pipe(empty) < 0)
+    fail("pipe");
+  // Both halves start out empty.
+  c = 0;
+  write(empty[1], &c, 1);
+  write(empty[1], &c, 1);
+
+  start = uptime();
+  if(fork() == 0){
+    for(total = 0; total < NBYTES; total += HALF){
+      if(read(empty[0], &c, 1) != 1)
+        fail("empty");
+      memset(p + (total/HALF % 2)*HALF, total/HALF, HALF);
+      write(full[1], &c, 1);
+    }
+    exit();
+  }
+  sum = 0;
+  for(total = 0; total < NBYTES; total += HALF){
+    if(read(full[0], &c, 1) != 1)
+      fail("full");
+    // Copy every byte out, as read() does from the pipe.
+    for(i = 0; i < HALF; i += CHUNK){
+      memmove(buf, p + (total/HALF % 2)*HALF + i, CHUNK);
+      sum += buf[CHUNK-1];
+    }
+    write(empty[1], &c, 1);
+  }
+  wait();
+  printf(1, "shm:  %d bytes in %d ticks%s\n", NBYTES, uptime() - start,
+         sum ? "" : "?");
+  close(full[0]);
+  close(full[1]);
+  close(empty[0]);
+  close(empty[1]);
+  shmdt(p);
+}
+
+int
+main(void)
+{
+  sharetest();
+  pipebench();
+  shmbench();
+  exit();
+}
@@ -0,0 +1,86 @@
+// Timer overhead benchmark.
+// For each count N, park N children in a long sleep() and measure
+// how much work a CPU-bound loop gets done per tick while they
+// sleep.  Sleepers that are woken only when their own deadline
+// expires cost nothing per tick, so the rate should stay flat as
+// N grows; sleepers that are all woken on every tick to re-check
+// their deadline make it fall.  Run with CPUS=1 so that the
+// loop and the timer work share one CPU.
+//
+// usage: sleepbench [N ...]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define RUNTIME 200    // ticks to run the loop for
+#define MAXKIDS 1000
+
+int counts[] = { 0, 100, 200, 400 };
+int pids[MAXKIDS];
+
+// Spin for RUNTIME ticks and return the number of iterations.
+uint
+spin(void)
+{
+  uint n, start, deadline;
+  int i;
+
+  // Start on a tick boundary.
+  start = uptime();
+  while(uptime() == start)
+    ;
+  deadline = start + 1 + RUNTIME;
+  for(n = 0; uptime() < deadline; n++)
+    for(i = 0; i < 1000; i++)
+      asm volatile("");
+  return n;
+}
+
+void
+run(int want)
+{
+  int i, n, pid;
+  uint iters;
+
+  if(want > MAXKIDS)
+    want = MAXKIDS;
+  for(n = 0; n < want; n++){
+    pid = fork();
+    if(pid < 0)
+      break;
+    if(pid == 0){
+      sleep(100000);
+      exit();
+    }
+    pids[n] = pid;
+  }
+  // Let every child reach sleep().
+  sleep(10);
+
+  iters = spin();
+  printf(1, "%d sleepers: %d iterations/tick\n", n, iters / RUNTIME);
+  if(n < want)
+    printf(1, "  (fork failed after %d children)\n", n);
+
+  for(i = 0; i < n; i++)
+    kill(pids[i]);
+  for(i = 0; i < n; i++)
+    wait();
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+
+  printf(1, "sleepbench: %d ticks per run\n", RUNTIME);
+  if(argc > 1){
+    for(i = 1; i < argc; i++)
+      run(atoi(argv[i]));
+  } else {
+    for(i = 0; i < sizeof(counts)/sizeof(counts[0]); i++)
+      run(counts[i]);
+  }
+  exit();
+}
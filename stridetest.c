@@ -0,0 +1,144 @@
+// Check that stride scheduling hands out CPU time in proportion
+// to tickets.  Runs one CPU-bound child per entry in tickets[],
+// lets them compete for a while, and compares the share of work
+// each one got with its share of the tickets.
+//
+// Stride scheduling divides each CPU's time among the processes
+// queued on that CPU, so the children must share one run queue.
+// The test counts the CPUs by how much work NCPU spinners get
+// done together, then keeps every CPU but its own busy with a
+// filler process, so that no idle CPU steals a child away.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+#include "sched.h"
+
+#define RUNTIME 500   // ticks to let the children compete
+#define CALTIME 50    // ticks to run spinners when counting CPUs
+#define SLACK   10    // allowed error, in percent of the expected share
+
+int tickets[] = { 100, 200, 300 };
+#define NCHILD (sizeof(tickets)/sizeof(tickets[0]))
+
+struct result {
+  int i;
+  uint n;
+};
+
+// Spin until deadline, counting loop iterations, and write the
+// count for child i to fd.
+void
+spin(int i, uint start, uint deadline, int fd)
+{
+  struct result r;
+  int j;
+
+  // Start together so that no child gets a head start.
+  while(uptime() < start)
+    ;
+  for(r.n = 0; uptime() < deadline; r.n++)
+    for(j = 0; j < 10000; j++)
+      asm volatile("");
+  r.i = i;
+  write(fd, &r, sizeof(r));
+  exit();
+}
+
+// Run n spinners for runtime ticks, the ith with tkt[i]
+// tickets unless tkt is 0, and store the counts in counts[].
+// Returns the total.
+uint
+run(int n, int *tkt, uint runtime, uint *counts)
+{
+  struct result r;
+  uint start, total;
+  int fds[2], i;
+
+  if(pipe(fds) < 0){
+    printf(2, "stridetest: pipe failed\n");
+    exit();
+  }
+  start = uptime() + 10;
+  for(i = 0; i < n; i++){
+    if(fork() == 0){
+      if(tkt && settickets(tkt[i]) < 0){
+        printf(2, "stridetest: settickets failed\n");
+        exit();
+      }
+      close(fds[0]);
+      spin(i, start, start + runtime, fds[1]);
+    }
+  }
+  close(fds[1]);
+
+  total = 0;
+  for(i = 0; i < n; i++)
+    counts[i] = 0;
+  while(read(fds[0], &r, sizeof(r)) == sizeof(r)){
+    counts[r.i] = r.n;
+    total += r.n;
+  }
+  close(fds[0]);
+  for(i = 0; i < n; i++)
+    wait();
+  return total;
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint counts[NCPU], total, one, ntickets, got, want;
+  int fillers[NCPU], i, ncpu, old, ok;
+
+  old = setsched(SCHED_STRIDE);
+  if(old < 0){
+    printf(2, "stridetest: setsched failed\n");
+    exit();
+  }
+  printf(1, "stridetest starting\n");
+
+  one = run(1, 0, CALTIME, counts);
+  total = run(NCPU, 0, CALTIME, counts);
+  ncpu = one ? (total + one/2) / one : 1;
+  if(ncpu < 1)
+    ncpu = 1;
+  if(ncpu > NCPU)
+    ncpu = NCPU;
+
+  for(i = 0; i < ncpu - 1; i++){
+    if((fillers[i] = fork()) == 0)
+      for(;;)
+        ;
+  }
+  // Let the other CPUs steal the fillers.
+  sleep(10);
+
+  total = run(NCHILD, tickets, RUNTIME, counts);
+  for(i = 0; i < ncpu - 1; i++){
+    kill(fillers[i]);
+    wait();
+  }
+  setsched(old);
+
+  if(total == 0){
+    printf(1, "stridetest: no progress\n");
+    exit();
+  }
+  ntickets = 0;
+  for(i = 0; i < NCHILD; i++)
+    ntickets += tickets[i];
+  ok = 1;
+  for(i = 0; i < NCHILD; i++){
+    // Shares in tenths of a percent.
+    got = counts[i] * 1000 / total;
+    want = tickets[i] * 1000 / ntickets;
+    printf(1, "tickets %d: share %d.%d%% expected %d.%d%%\n",
+           tickets[i], got / 10, got % 10, want / 10, want % 10);
+    if(got * 100 < want * (100 - SLACK) || got * 100 > want * (100 + SLACK))
+      ok = 0;
+  }
+  printf(1, ok ? "stridetest OK\n" : "stridetest FAILED\n");
+  exit();
+}
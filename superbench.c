@@ -0,0 +1,60 @@
+// Superpage benchmark.
+// In a child with superpages off and then one with them on,
+// grow the heap by MB megabytes, touch every page, and time
+// passes over it that touch one byte per page, so that each
+// access needs a TLB entry of its own with 4 KB pages.  Also
+// report the memory used, which includes the page tables.
+//
+// usage: superbench [mb]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define PGSIZE 4096
+#define PASSES 50
+
+void
+run(int mb, int on)
+{
+  char *p, *heap;
+  uint start, sum;
+  int before, i;
+
+  superpages(on);
+  before = freemem();
+  if((heap = sbrk(mb*1024*1024)) == (char*)-1){
+    printf(2, "superbench: sbrk failed\n");
+    exit();
+  }
+  for(p = heap; p < heap + mb*1024*1024; p += PGSIZE)
+    *p = 1;
+  printf(1, "superpages %s: %d KB used, ", on ? "on" : "off",
+         (before - freemem()) * (PGSIZE / 1024));
+
+  sum = 0;
+  start = uptime();
+  for(i = 0; i < PASSES; i++)
+    for(p = heap; p < heap + mb*1024*1024; p += PGSIZE)
+      sum += *p;
+  printf(1, "%d ticks for %d passes%s\n", uptime() - start, PASSES,
+         sum ? "" : "?");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb, on;
+
+  mb = 32;
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  for(on = 0; on <= 1; on++){
+    if(fork() == 0){
+      run(mb, on);
+      exit();
+    }
+    wait();
+  }
+  exit();
+}
@@ -0,0 +1,275 @@
+// Swap space.
+//
+// When memory runs out, kallocswap() writes pages that have not
+// been used lately out to the swap area, which follows the file
+// system on its disk (see fs.h), and uvmfault() reads them back
+// in when they are touched again.  A swapped-out page's PTE has
+// PTE_P clear and PTE_SWAP set, and holds the page's swap slot
+// in place of its address.  fork() shares slots the way it
+// shares pages, so each slot has a reference count.
+//
+// Pages are picked with the clock algorithm: a hand sweeps over
+// every process's user pages in pid order, clearing the accessed
+// bit of each page it passes, and takes the first page whose bit
+// is already clear, i.e. one not used since the hand last went
+// by.  Only pages that belong to one process alone are taken,
+// not copy-on-write, page cache or shared memory pages, and only
+// from processes that cannot use them meanwhile (see swappable() in proc.c).
+//
+// A page is written out while it is still mapped, with its
+// dirty bit cleared first, and only unmapped if afterwards its
+// PTE is exactly as it was; a page that was used in the meantime
+// stays where it is.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "fs.h"
+#include "buf.h"
+
+#define SPP       (PGSIZE/BSIZE)  // disk blocks per page
+#define SWAPBATCH 16              // pages freed per swapout()
+#define SWAPSCAN  64              // PTEs looked at per hold of p->lock
+
+struct {
+  struct spinlock lock;
+  ushort ref[NSWAP];           // References to each slot, 0 if free
+
+  struct sleeplock outlock;    // One swapout() at a time; protects:
+  int handpid;                 // Clock hand: process
+  uint handva;                 // and user address in it
+  struct buf outbuf;           // For writing pages out
+
+  struct buf inbuf;            // For reading pages in
+} swap;
+
+void
+swapinit(void)
+{
+  initlock(&swap.lock, "swap");
+  initsleeplock(&swap.outlock, "swapout");
+  initsleeplock(&swap.outbuf.lock, "swapout buf");
+  initsleeplock(&swap.inbuf.lock, "swapin buf");
+}
+
+// Read or write the page mem from or to slot through b, whose
+// lock the caller holds.
+static void
+swaprw(struct buf *b, int slot, char *mem, int write)
+{
+  int i;
+
+  for(i = 0; i < SPP; i++){
+    b->dev = ROOTDEV;
+    b->blockno = SWAPSTART + slot*SPP + i;
+    if(write){
+      memmove(b->data, mem + i*BSIZE, BSIZE);
+      b->flags = B_DIRTY;
+    } else
+      b->flags = 0;
+    iderw(b);
+    if(!write)
+      memmove(mem + i*BSIZE, b->data, BSIZE);
+  }
+}
+
+// Allocate a slot with one reference.  Returns -1 if swap is full.
+static int
+swapalloc(void)
+{
+  int slot;
+
+  acquire(&swap.lock);
+  for(slot = 0; slot < NSWAP; slot++){
+    if(swap.ref[slot] == 0){
+      swap.ref[slot] = 1;
+      release(&swap.lock);
+      return slot;
+    }
+  }
+  release(&swap.lock);
+  return -1;
+}
+
+// Add a reference to slot, for a copy of a PTE that holds it.
+void
+swapdup(int slot)
+{
+  acquire(&swap.lock);
+  if(slot < 0 || slot >= NSWAP || swap.ref[slot] == 0)
+    panic("swapdup");
+  swap.ref[slot]++;
+  release(&swap.lock);
+}
+
+// Drop a reference to slot.
+void
+swapfree(int slot)
+{
+  acquire(&swap.lock);
+  if(slot < 0 || slot >= NSWAP || swap.ref[slot] == 0)
+    panic("swapfree");
+  swap.ref[slot]--;
+  release(&swap.lock);
+}
+
+// Move the clock hand *va over up to SWAPSCAN user pages of
+// pgdir, clearing accessed bits, and return the PTE of the first
+// page that may be swapped out and has not been used since the
+// hand last passed it, or 0.  *va is left just past that page, or
+// at KERNBASE once the hand reaches the end of user memory.
+static pte_t*
+clockscan(pde_t *pgdir, uint *va)
+{
+  pte_t *pte;
+  uint a;
+  int i;
+
+  for(i = 0; i < SWAPSCAN && *va < KERNBASE; i++){
+    a = *va;
+    // Superpages are not swapped.
+    if((pgdir[PDX(a)] & (PTE_P|PTE_PS)) != PTE_P){
+      *va = PGADDR(PDX(a) + 1, 0, 0);
+      continue;
+    }
+    *va += PGSIZE;
+    pte = walkpgdir(pgdir, (char*)a, 0);
+    if((*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U))
+      continue;
+    if(*pte & PTE_A){
+      *pte &= ~PTE_A;
+      continue;
+    }
+    if(krefcount(P2V(PTE_ADDR(*pte))) == 1)
+      return pte;
+  }
+  return 0;
+}
+
+// Swap out up to SWAPBATCH pages.  Gives up after the clock hand
+// has gone around twice without finding enough.  Returns the
+// number of pages freed.
+int
+swapout(void)
+{
+  struct proc *p;
+  pde_t *pgdir;
+  pte_t *pte, old;
+  uint va;
+  int n, pid, slot, laps;
+  char *mem;
+
+  acquiresleep(&swap.outlock);
+  n = 0;
+  laps = 0;
+  while(n < SWAPBATCH){
+    // Go on with the process the hand is in, unless it is done
+    // or may no longer be swapped from; else on to the next.
+    p = 0;
+    if(swap.handva)
+      p = swapproc(swap.handpid);
+    if(p == 0){
+      if((p = swapnext()) == 0){
+        if(++laps > 2)
+          break;
+        continue;
+      }
+      swap.handpid = p->pid;
+      swap.handva = 0;
+    }
+    pte = clockscan(p->pgdir, &swap.handva);
+    if(pte == 0){
+      if(swap.handva >= KERNBASE)
+        swap.handva = 0;
+      // The TLB may hold the accessed bits we cleared.
+      if(p == myproc())
+        lcr3(V2P(p->pgdir));
+      release(&p->lock);
+      continue;
+    }
+
+    // Write the page out with our own reference to it, so that
+    // it cannot be freed and reused meanwhile.
+    *pte &= ~PTE_D;
+    old = *pte;
+    if(p == myproc())
+      lcr3(V2P(p->pgdir));
+    mem = P2V(PTE_ADDR(old));
+    kincref(mem);
+    pid = p->pid;
+    pgdir = p->pgdir;
+    va = swap.handva - PGSIZE;
+    release(&p->lock);
+
+    if((slot = swapalloc()) < 0){
+      kfree(mem);
+      break;
+    }
+    acquiresleep(&swap.outbuf.lock);
+    swaprw(&swap.outbuf, slot, mem, 1);
+    releasesleep(&swap.outbuf.lock);
+
+    // The process may have exec'd into a recycled page
+    // directory at the same address, without this page table.
+    p = swapproc(pid);
+    if(p && p->pgdir == pgdir &&
+       (pgdir[PDX(va)] & PTE_PS) == 0 &&
+       (pte = walkpgdir(pgdir, (char*)va, 0)) != 0 && *pte == old){
+      *pte = (slot << PTXSHIFT) | (PTE_FLAGS(old) & ~PTE_P) | PTE_SWAP;
+      if(p == myproc())
+        lcr3(V2P(p->pgdir));
+      kfree(mem);
+      n++;
+    } else
+      swapfree(slot);
+    if(p)
+      release(&p->lock);
+    kfree(mem);
+  }
+  releasesleep(&swap.outlock);
+  return n;
+}
+
+// Read the swapped-out page at va in pgdir, which belongs to the
+// current process, back in.  Returns 0, or -1 if out of memory.
+int
+swapin(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  int slot;
+  char *mem;
+
+  if((mem = kallocswap(0)) == 0)
+    return -1;
+  pte = walkpgdir(pgdir, (char*)va, 0);
+  slot = PTE_SLOT(*pte);
+  acquiresleep(&swap.inbuf.lock);
+  swaprw(&swap.inbuf, slot, mem, 0);
+  releasesleep(&swap.inbuf.lock);
+  *pte = V2P(mem) | (PTE_FLAGS(*pte) & ~PTE_SWAP) | PTE_P | PTE_A;
+  swapfree(slot);
+  return 0;
+}
+
+// Allocate a page like kalloc(), or zeroed like kalloczero() if
+// zero is set, swapping pages out to make room if memory has run
+// out.  May sleep, so the caller must not hold a spinlock.
+char*
+kallocswap(int zero)
+{
+  char *mem;
+  int i;
+
+  // Pages freed by swapout() land in the cache of whichever
+  // CPU it ran on, so try a few times.
+  for(i = 0; (mem = zero ? kalloczero() : kalloc()) == 0 && i < 4; i++)
+    if(swapout() == 0)
+      break;
+  return mem;
+}
@@ -0,0 +1,72 @@
+// Swap test: oversubscribe memory with batch jobs.
+// Starts NJOB processes that between them touch all of free
+// memory and half as many pages again as there is swap space,
+// each writing its pages and then checking them on every pass.
+// A job that finishes says so with a byte on a pipe; without
+// swap they run out of memory and are killed instead.
+//
+// usage: swaptest
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "param.h"
+
+#define PGSIZE 4096
+#define NJOB   3
+#define PASSES 3
+
+int done[2];
+
+void
+job(int id, int npages)
+{
+  char *p;
+  int i, pass;
+
+  if((p = sbrk(npages*PGSIZE)) == (char*)-1){
+    printf(1, "swaptest: job %d: sbrk failed\n", id);
+    exit();
+  }
+  for(pass = 0; pass < PASSES; pass++){
+    for(i = 0; i < npages; i++){
+      if(pass > 0 && *(int*)(p + i*PGSIZE) != id*npages + i + pass - 1){
+        printf(1, "swaptest: job %d: page %d lost FAILED\n", id, i);
+        exit();
+      }
+      *(int*)(p + i*PGSIZE) = id*npages + i + pass;
+    }
+  }
+  write(done[1], "x", 1);
+  exit();
+}
+
+int
+main(void)
+{
+  int i, npages, ok;
+  uint start;
+  char c;
+
+  npages = (freemem() + NSWAP/2) / NJOB;
+  printf(1, "%d jobs of %d pages, %d pages free\n", NJOB, npages, freemem());
+  if(pipe(done) < 0){
+    printf(1, "swaptest: pipe failed\n");
+    exit();
+  }
+  start = uptime();
+  for(i = 0; i < NJOB; i++){
+    if(fork() == 0)
+      job(i, npages);
+  }
+  close(done[1]);
+  for(i = 0; i < NJOB; i++)
+    wait();
+  for(ok = 0; read(done[0], &c, 1) == 1; ok++)
+    ;
+  printf(1, "%d of %d jobs ok in %d ticks, %d pages free\n",
+         ok, NJOB, uptime() - start, freemem());
+  if(ok != NJOB)
+    printf(1, "swaptest FAILED\n");
+  exit();
+}
@@ -3,6 +3,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
@@ -17,8 +18,11 @@
 int fetchint(uint addr, int *ip)
 {
   struct proc *curproc = myproc();
+  uint end;
   /*kernel must verify that the pointer lies within the user part of the address space*/
-  if (addr >= curproc->sz || addr + 4 > curproc->sz) 
+  if ((end = userend(curproc, addr)) == 0 || addr + 4 > end)
+    return -1;
+  if (uvmprefault(curproc, addr, 4, 0) < 0)
     return -1;
   /*
    * fetchint can cast the address to a pointer,
@@ -36,13 +40,17 @@ int fetchstr(uint addr, char **pp)
 {
   char *s, *ep;
   struct proc *curproc = myproc();
+  uint end;
 
-  if (addr >= curproc->sz)
+  if ((end = userend(curproc, addr)) == 0)
     return -1;
   *pp = (char *)addr;
-  ep = (char *)curproc->sz;
+  ep = (char *)end;
   for (s = *pp; s < ep; s++)
   {
+    if ((s == *pp || (uint)s % PGSIZE == 0) &&
+        uvmprefault(curproc, (uint)s, 1, 0) < 0)
+      return -1;
     if (*s == 0)
       return s - *pp;
   }
@@ -58,24 +66,42 @@ int argint(int n, int *ip)
 
 // Fetch the nth word-sized system call argument as a pointer
 // to a block of memory of size bytes.  Check that the pointer
-// lies within the process address space.
-int argptr(int n, char **pp, int size)
+// lies within the process address space, and fault the block in
+// (writable if write is set) so that the kernel can use it.
+static int
+argblock(int n, char **pp, int size, int write)
 {
   int i;
+  uint end;
   struct proc *curproc = myproc();
 
   if (argint(n, &i) < 0)
     return -1;
-  if (size < 0 || (uint)i >= curproc->sz || (uint)i + size > curproc->sz)
+  if (size < 0 || (end = userend(curproc, i)) == 0 || (uint)i + size > end)
+    return -1;
+  if (uvmprefault(curproc, i, size, write) < 0)
     return -1;
   *pp = (char *)i;
   return 0;
 }
 
+// A block the kernel only reads.
+int argptr(int n, char **pp, int size)
+{
+  return argblock(n, pp, size, 0);
+}
+
+// A block the kernel writes to.
+int argptrw(int n, char **pp, int size)
+{
+  return argblock(n, pp, size, 1);
+}
+
 // Fetch the nth word-sized system call argument as a string pointer.
 // Check that the pointer is valid and the string is nul-terminated.
-// (There is no shared writable memory, so the string can't change
-// between this check and being used by the kernel.)
+// (A string in a shared memory segment could change between this
+// check and being used by the kernel, so callers must not rely on
+// more than its first nul.)
 int argstr(int n, char **pp)
 {
   int addr;
@@ -107,6 +133,18 @@ extern int sys_write(void);
 extern int sys_uptime(void);
 extern int sys_date(void);
 extern int sys_alarm(void);
+extern int sys_setpriority(void);
+extern int sys_settickets(void);
+extern int sys_setsched(void);
+extern int sys_getrusage(void);
+extern int sys_freemem(void);
+extern int sys_buddyinfo(void);
+extern int sys_superpages(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_shmget(void);
+extern int sys_shmat(void);
+extern int sys_shmdt(void);
 
 /*声明一个函数数组, 不接受参数, 返回一个整数*/
 static int (*syscalls[])(void) = {
@@ -133,6 +171,18 @@ static int (*syscalls[])(void) = {
     [SYS_close] sys_close,
     [SYS_date] sys_date,
     [SYS_alarm] sys_alarm,
+    [SYS_setpriority] sys_setpriority,
+    [SYS_settickets] sys_settickets,
+    [SYS_setsched] sys_setsched,
+    [SYS_getrusage] sys_getrusage,
+    [SYS_freemem] sys_freemem,
+    [SYS_buddyinfo] sys_buddyinfo,
+    [SYS_superpages] sys_superpages,
+    [SYS_mmap] sys_mmap,
+    [SYS_munmap] sys_munmap,
+    [SYS_shmget] sys_shmget,
+    [SYS_shmat] sys_shmat,
+    [SYS_shmdt] sys_shmdt,
 };
 
 /*static char *syscall_name[23] = {
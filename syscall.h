@@ -22,3 +22,15 @@
 #define SYS_close  21
 #define SYS_date   22
 #define SYS_alarm  23
+#define SYS_setpriority 24
+#define SYS_settickets 25
+#define SYS_setsched 26
+#define SYS_getrusage 27
+#define SYS_freemem 28
+#define SYS_buddyinfo 29
+#define SYS_superpages 30
+#define SYS_mmap 31
+#define SYS_munmap 32
+#define SYS_shmget 33
+#define SYS_shmat 34
+#define SYS_shmdt 35
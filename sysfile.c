@@ -9,12 +9,13 @@
 #include "param.h"
 #include "stat.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "fs.h"
-#include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "mman.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -73,7 +74,7 @@ sys_read(void)
   int n;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptrw(1, &p, n) < 0)
     return -1;
   return fileread(f, p, n);
 }
@@ -109,7 +110,7 @@ sys_fstat(void)
   struct file *f;
   struct stat *st;
 
-  if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+  if(argfd(0, 0, &f) < 0 || argptrw(1, (void*)&st, sizeof(*st)) < 0)
     return -1;
   return filestat(f, st);
 }
@@ -427,7 +428,7 @@ sys_pipe(void)
   struct file *rf, *wf;
   int fd0, fd1;
 
-  if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
+  if(argptrw(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
     return -1;
   if(pipealloc(&rf, &wf) < 0)
     return -1;
@@ -443,3 +444,33 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+// Map anonymous memory, or part of an open file read-only,
+// private to the process.  The address hint must be 0.
+int
+sys_mmap(void)
+{
+  int addr, len, prot, flags, off, type;
+  struct file *f;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || argint(2, &prot) < 0 ||
+     argint(3, &flags) < 0 || argint(5, &off) < 0)
+    return -1;
+  if(addr != 0 || len <= 0 || (prot & ~(PROT_READ|PROT_WRITE)) ||
+     (flags & ~(MAP_PRIVATE|MAP_ANONYMOUS)) || !(flags & MAP_PRIVATE))
+    return -1;
+  f = 0;
+  if(!(flags & MAP_ANONYMOUS)){
+    if(argfd(4, 0, &f) < 0)
+      return -1;
+    if(f->type != FD_INODE || !f->readable || (prot & PROT_WRITE) ||
+       off < 0 || off % PGSIZE)
+      return -1;
+    ilock(f->ip);
+    type = f->ip->type;
+    iunlock(f->ip);
+    if(type == T_DEV)
+      return -1;
+  }
+  return mmap(f, 0, len, prot, off);
+}
@@ -5,7 +5,9 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
+#include "rusage.h"
 
 int sys_fork(void)
 {
@@ -55,20 +57,29 @@ int sys_sleep(void)
 {
   int n;
   uint ticks0;
+  struct timer t;
 
   if (argint(0, &n) < 0)
     return -1;
+  // Sleep on our own timer, so that only we are woken when it
+  // expires, rather than every sleeper on every tick.
+  timerinit(&t, wakeup, &t);
+  tickupdate();
   acquire(&tickslock);
   ticks0 = ticks;
   while (ticks - ticks0 < n)
   {
     if (myproc()->killed)
     {
+      timerdel(&t);
       release(&tickslock);
       return -1;
     }
-    sleep(&ticks, &tickslock);
+    if (!t.pending)
+      timeradd(&t, ticks0 + n);
+    sleep(&t, &tickslock);
   }
+  timerdel(&t);
   release(&tickslock);
   return 0;
 }
@@ -79,6 +90,7 @@ int sys_uptime(void)
 {
   uint xticks;
 
+  tickupdate();
   acquire(&tickslock);
   xticks = ticks;
   release(&tickslock);
@@ -102,14 +114,161 @@ int sys_date(void)
 int
 sys_alarm(void)
 {
-  int ticks;
+  int n;
   void (*handler)();
-  if(argint(0, &ticks) < 0)
+  if(argint(0, &n) < 0)
     return -1;
   if(argptr(1, (char**)&handler, 1) < 0)
     return -1;
   /*获取到alarm()系统调用参数后，将其赋值给当前进程的成员*/
-  myproc()->alarmticks = ticks;
+  /*每alarmticks个tick由timer wheel触发一次, ticks为0则取消*/
+  tickupdate();
+  acquire(&tickslock);
+  timerdel(&myproc()->alarmtimer);
+  myproc()->alarmticks = n;
   myproc()->alarmhandler = handler;
+  myproc()->alarmpending = 0;
+  if (n > 0)
+    timeradd(&myproc()->alarmtimer, ticks + n);
+  release(&tickslock);
   return 0;
-}
\ No newline at end of file
+}
+
+// Set the highest scheduling level (0 is highest) that process
+// pid may run at; larger values are "nicer" to other processes.
+int
+sys_setpriority(void)
+{
+  int pid, prio;
+
+  if(argint(0, &pid) < 0 || argint(1, &prio) < 0)
+    return -1;
+  return setpriority(pid, prio);
+}
+
+// Give the calling process n tickets for stride scheduling.
+int
+sys_settickets(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+  return settickets(n);
+}
+
+// Switch the scheduling policy (see sched.h); returns the old one.
+int
+sys_setsched(void)
+{
+  int which;
+
+  if(argint(0, &which) < 0)
+    return -1;
+  return setsched(which);
+}
+
+// Report the resource usage of the calling process (RUSAGE_SELF)
+// or of its children that have been waited for (RUSAGE_CHILDREN).
+int
+sys_getrusage(void)
+{
+  int who;
+  struct rusage *ru;
+  struct proc *p = myproc();
+
+  if(argint(0, &who) < 0 || argptrw(1, (char**)&ru, sizeof(*ru)) < 0)
+    return -1;
+  if(who == RUSAGE_SELF){
+    ru->utime = p->utime;
+    ru->stime = p->stime;
+    ru->nvcsw = p->nvcsw;
+    ru->nivcsw = p->nivcsw;
+    ru->nfault = p->nfault;
+  } else if(who == RUSAGE_CHILDREN){
+    ru->utime = p->cutime;
+    ru->stime = p->cstime;
+    ru->nvcsw = p->cnvcsw;
+    ru->nivcsw = p->cnivcsw;
+    ru->nfault = p->cnfault;
+  } else
+    return -1;
+  return 0;
+}
+
+// Return the number of free physical pages.
+int
+sys_freemem(void)
+{
+  return kfreepages();
+}
+
+// Fill in the number of free blocks of each order, 0..MAXORDER,
+// in the physical page allocator.  Returns MAXORDER+1.
+int
+sys_buddyinfo(void)
+{
+  uint *nblock;
+
+  if(argptrw(0, (char**)&nblock, (MAXORDER+1)*sizeof(uint)) < 0)
+    return -1;
+  kbuddyinfo(nblock);
+  return MAXORDER+1;
+}
+
+// Turn 4 MB superpages for the heap on or off for this process
+// and its future children (see uvmfault).  Heap already mapped
+// stays as it is.  Returns the previous setting.
+int
+sys_superpages(void)
+{
+  int on, old;
+
+  if(argint(0, &on) < 0)
+    return -1;
+  old = myproc()->superpages;
+  myproc()->superpages = (on != 0);
+  return old;
+}
+
+int
+sys_munmap(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0)
+    return -1;
+  return munmap(addr, len);
+}
+
+// Return the id of the shared memory segment with the given
+// key, creating it if needed (see shm.c).
+int
+sys_shmget(void)
+{
+  int key, size;
+
+  if(argint(0, &key) < 0 || argint(1, &size) < 0 || size < 0)
+    return -1;
+  return shmget(key, size);
+}
+
+int
+sys_shmat(void)
+{
+  int id;
+
+  if(argint(0, &id) < 0)
+    return -1;
+  return shmat(id);
+}
+
+int
+sys_shmdt(void)
+{
+  int addr;
+
+  if(argint(0, &addr) < 0)
+    return -1;
+  return shmdt(addr);
+}
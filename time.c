@@ -0,0 +1,43 @@
+// Run a command and report the CPU time and other resources
+// it used.
+//
+// usage: time cmd [args...]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "rusage.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct rusage ru;
+  uint start, end;
+  int pid;
+
+  if(argc < 2){
+    printf(2, "usage: time cmd [args...]\n");
+    exit();
+  }
+  start = uptime();
+  pid = fork();
+  if(pid < 0){
+    printf(2, "time: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[1], argv+1);
+    printf(2, "time: exec %s failed\n", argv[1]);
+    exit();
+  }
+  wait();
+  end = uptime();
+  if(getrusage(RUSAGE_CHILDREN, &ru) < 0){
+    printf(2, "time: getrusage failed\n");
+    exit();
+  }
+  printf(2, "%d real %d user %d sys ticks\n", end - start, ru.utime, ru.stime);
+  printf(2, "%d voluntary %d involuntary switches, %d page faults\n",
+         ru.nvcsw, ru.nivcsw, ru.nfault);
+  exit();
+}
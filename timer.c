@@ -0,0 +1,195 @@
+// Kernel timers.
+//
+// A hierarchical timer wheel holds every pending timer, keyed
+// by the tick at which it expires.  Level 0 has one slot per tick
+// for the next 64 ticks; each higher level has slots 64 times
+// coarser.  When the wheel's clock crosses a slot boundary of a
+// higher level, that slot's timers are cascaded down to the finer
+// levels.  Adding, deleting and expiring a timer are all O(1), and
+// a tick with nothing due costs the same no matter how many timers
+// are pending.
+//
+// Timers are protected by tickslock.  The wheel's clock is
+// advanced together with ticks by tickupdate(), and a timer's
+// function is called with tickslock held when it expires.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "proc.h"
+
+#define WHEELBITS  6
+#define WHEELSIZE  (1 << WHEELBITS)   // slots per level
+#define WHEELMASK  (WHEELSIZE - 1)
+#define NLEVEL     4                  // wheel spans 2^24 ticks
+
+static struct {
+  uint clock;                           // last tick processed
+  struct timer *slot[NLEVEL][WHEELSIZE];
+  int n;                                // number of pending timers
+  uint next;                            // no timer expires before this
+} wheel;
+
+void
+timerinit(struct timer *t, void (*fn)(void*), void *arg)
+{
+  t->fn = fn;
+  t->arg = arg;
+  t->pending = 0;
+  t->next = 0;
+  t->pprev = 0;
+}
+
+// Link t into the slot for t->expires.  t->expires must not be
+// before wheel.clock; a timer due at wheel.clock goes into the
+// level 0 slot that timerrun() is about to expire.
+static void
+place(struct timer *t)
+{
+  struct timer **head;
+  uint d;
+  int level;
+
+  d = t->expires - wheel.clock;
+  for(level = 0; level < NLEVEL-1; level++)
+    if(d < 1U << (WHEELBITS * (level+1)))
+      break;
+  head = &wheel.slot[level][(t->expires >> (WHEELBITS * level)) & WHEELMASK];
+  t->next = *head;
+  if(t->next)
+    t->next->pprev = &t->next;
+  t->pprev = head;
+  *head = t;
+}
+
+static void
+unlink(struct timer *t)
+{
+  *t->pprev = t->next;
+  if(t->next)
+    t->next->pprev = t->pprev;
+  t->next = 0;
+  t->pprev = 0;
+}
+
+// Arrange for t->fn(t->arg) to be called at tick expires.
+// A deadline that has already passed fires on the next tick.
+// tickslock must be held.
+void
+timeradd(struct timer *t, uint expires)
+{
+  if(!holding(&tickslock))
+    panic("timeradd");
+  if(t->pending)
+    panic("timeradd pending");
+  if((int)(expires - wheel.clock) <= 0)
+    expires = wheel.clock + 1;
+  if(expires - wheel.clock >= 1U << (WHEELBITS * NLEVEL))
+    expires = wheel.clock + (1U << (WHEELBITS * NLEVEL)) - 1;
+  t->expires = expires;
+  t->pending = 1;
+  place(t);
+  if(wheel.n++ == 0 || (int)(expires - wheel.next) < 0)
+    wheel.next = expires;
+}
+
+// Cancel t if it has not fired yet.  tickslock must be held.
+void
+timerdel(struct timer *t)
+{
+  if(!holding(&tickslock))
+    panic("timerdel");
+  if(!t->pending)
+    return;
+  unlink(t);
+  t->pending = 0;
+  wheel.n--;
+}
+
+// Move the timers in slot idx of level down to finer levels.
+static void
+cascade(int level, int idx)
+{
+  struct timer *t, *next;
+
+  t = wheel.slot[level][idx];
+  wheel.slot[level][idx] = 0;
+  for(; t; t = next){
+    next = t->next;
+    place(t);
+  }
+}
+
+// Advance the wheel to tick now, calling the function of every
+// timer that expires on the way.  Called by tickupdate() with
+// tickslock held.
+void
+timerrun(uint now)
+{
+  struct timer *t, *list;
+  int level, idx;
+
+  if(wheel.n == 0){
+    wheel.clock = now;
+    return;
+  }
+  while((int)(now - wheel.clock) > 0){
+    wheel.clock++;
+    // On a level boundary, cascade the next slot of each
+    // coarser level whose boundary was crossed too.
+    for(level = 1; level < NLEVEL; level++){
+      if(wheel.clock & ((1U << (WHEELBITS * level)) - 1))
+        break;
+      cascade(level, (wheel.clock >> (WHEELBITS * level)) & WHEELMASK);
+    }
+
+    // Detach the slot first: a function may add its timer again.
+    idx = wheel.clock & WHEELMASK;
+    list = wheel.slot[0][idx];
+    wheel.slot[0][idx] = 0;
+    if(list)
+      list->pprev = &list;
+    while((t = list) != 0){
+      unlink(t);
+      t->pending = 0;
+      wheel.n--;
+      t->fn(t->arg);
+    }
+    if(wheel.n == 0){
+      wheel.clock = now;
+      return;
+    }
+  }
+}
+
+// Return the number of ticks until the next timer could expire,
+// at least 1, or 0 if no timer is pending.  wheel.next is a lower
+// bound that deletions may leave stale; once it has passed,
+// recompute it exactly by looking at every pending timer.
+// tickslock must be held.
+uint
+timernext(void)
+{
+  struct timer *t;
+  int level, idx, found;
+
+  if(wheel.n == 0)
+    return 0;
+  if((int)(wheel.next - wheel.clock) <= 0){
+    found = 0;
+    for(level = 0; level < NLEVEL; level++){
+      for(idx = 0; idx < WHEELSIZE; idx++){
+        for(t = wheel.slot[level][idx]; t; t = t->next){
+          if(!found || (int)(t->expires - wheel.next) < 0)
+            wheel.next = t->expires;
+          found = 1;
+        }
+      }
+    }
+    if((int)(wheel.next - wheel.clock) <= 0)
+      return 1;
+  }
+  return wheel.next - wheel.clock;
+}
@@ -3,17 +3,17 @@
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "x86.h"
 #include "traps.h"
-#include "spinlock.h"
 
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
-int mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm);
+static uint64 tsclast;  // TSC at the start of the current tick
 
 /*
  * set up the 256 entries in the IDT
@@ -46,6 +46,47 @@ idtinit(void)
   lidt(idt, sizeof(idt));
 }
 
+// Bring ticks up to date with the TSC, which keeps counting
+// whether or not any CPU takes timer interrupts, and run the
+// timers that have expired.
+// Called from every timer interrupt and before ticks is read.
+void
+tickupdate(void)
+{
+  uint64 now;
+  uint old, new;
+
+  acquire(&tickslock);
+  now = rdtsc();
+  if(tsclast == 0)
+    tsclast = now;
+  old = ticks;
+  // Signed: this CPU's TSC may be a little behind the one
+  // that last advanced tsclast.
+  while((long long)(now - tsclast) >= tsctick){
+    tsclast += tsctick;
+    ticks++;
+  }
+  timerrun(ticks);
+  new = ticks;
+  release(&tickslock);
+  if(new/BOOSTTICKS != old/BOOSTTICKS)
+    boost();
+}
+
+// Number of ticks until the next timer expires, at least 1,
+// or 0 if no timer is pending.
+uint
+ticknextwake(void)
+{
+  uint n;
+
+  acquire(&tickslock);
+  n = timernext();
+  release(&tickslock);
+  return n;
+}
+
 //PAGEBREAK: 41
 /*
  * system call, device interrupt and faults 等都会从trapasm.S进入这个函数
@@ -58,62 +99,37 @@ trap(struct trapframe *tf)
       exit();
     myproc()->tf = tf;
     syscall(); /*此时系统调用的返回值存储在tf->%eax中*/
+    myproc()->upin = 0;
     if(myproc()->killed)
       exit();
     return;
   }
 
-  /*处理Page Fault的代码添加在这里*/
-  //if (tf->trapno == T_PGFLT) /*只有Page Fault才处理*/
-  //{
-  //  pde_t *pde;
-  //  pte_t *pgtab;
-  //  pde_t *pte;
-  //  char *mem;
-  //  struct proc *curproc = myproc();
-  //  uint va;
-  //  /*得到造成Page Fault的虚拟地址，说明这个虚拟地址没有映射到的物理地址*/
-  //  va = PGROUNDDOWN(rcr2()); /*rounddown到虚拟地址页边界*/
-  //  cprintf("sz: %x\n", curproc->sz);
-  //  cprintf("rcr2  va: %x\n", rcr2());
-  //  cprintf("round va: %x\n", va);
-  //  /*分配一页物理内存*/
-  //  mem = kalloc();
-  //  memset(mem, 0, PGSIZE);
-  //  cprintf("pa1: %x\n", V2P(mem));
-  //  pde = &((curproc->pgdir)[PDX(rcr2())]);
-  //  pgtab = P2V(PTE_ADDR(*pde));
-  //  pte = &pgtab[PTX(rcr2())];
-  //  cprintf("Before Map PDE: %x\n", (curproc->pgdir[PDX(rcr2())]));
-  //  cprintf("Before Map PTE: %x\n", *pte );
-  //  cprintf("Before Map cal PA: %x\n",  PTE_ADDR((*pte)) + (rcr2() & 0b111111111111) );
-  //  /*建立PTE完成映射*/
-  //  memset(mem, 0, PGSIZE);
-  //  mappages(curproc->pgdir, (char *)va, PGSIZE, V2P(mem), PTE_W|PTE_U);  
-  //  pde = &((curproc->pgdir)[PDX(rcr2())]);
-  //  pgtab = P2V(PTE_ADDR(*pde));
-  //  pte = &pgtab[PTX(rcr2())];
-  //  cprintf("After Map PDE: %x\n", (curproc->pgdir[PDX(rcr2())]));
-  //  cprintf("After Map PTE: %x\n",  *pte );
-  //  cprintf("After Map cal PA: %x\n",  PTE_ADDR((*pte)) + (rcr2() & 0b111111111111) );
-  //  return;
-  //}
-
   switch(tf->trapno){
 
   case T_IRQ0 + IRQ_TIMER:
-    if(cpuid() == 0){
-      acquire(&tickslock);
-      ticks++;
-      wakeup(&ticks);
-      release(&tickslock);
+    // Charge the tick to whatever was running: user or system
+    // time of the current process, or nothing if idle.
+    if(myproc()){
+      if((tf->cs & 3) == DPL_USER)
+        myproc()->utime++;
+      else
+        myproc()->stime++;
     }
+    tickupdate();
     lapiceoi();
+    // In tickless mode a busy CPU re-arms one tick ahead; an
+    // idle CPU leaves that to idle(), which picks its own deadline.
+    if(TICKLESS && !mycpu()->idle)
+      lapictimer(1);
     /*只处理在用户态时接受到的timer中断*/
+    /*alarmtimer到期后由alarmexpire()设置alarmpending*/
     if (myproc() != 0 && (tf->cs & 3) == 3)
     {
-      myproc()->tick_counts++;
-      if (myproc()->tick_counts == myproc()->alarmticks)
+      // The user stack page may be in swap or copy-on-write.
+      if (myproc()->alarmpending &&
+          uvmprefault(myproc(), tf->esp - 4, 4, 1) == 0 &&
+          xchg(&myproc()->alarmpending, 0))
       {
         /*首先需要保存现在trapframe中的eip值，也就是在for循环中停止(陷入)的地方*/
         tf->esp -= 4;
@@ -123,10 +139,15 @@ trap(struct trapframe *tf)
          * 所以将trapframe里的eip设置为alarmhandler函数的值，使一返回到用户态就执行alarmhandler里保存的函数
          */ 
         tf->eip = (uint)myproc()->alarmhandler; 
-        myproc()->tick_counts = 0;
       }      
+      myproc()->upin = 0;
     }
     
+    break;
+  case T_IRQ0 + IRQ_RESCHED:
+    // Sent by kick() to wake a halted CPU; scheduler()
+    // looks at the run queues once hlt returns.
+    lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
     ideintr(); /*处理来自磁盘的中断*/
@@ -150,6 +171,16 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_PGFLT:
+    /*处理Page Fault: 按需读入的程序页, 按需分配的heap页, 或copy-on-write的页*/
+    // From user space, or from a system call using user memory.
+    if(myproc())
+      myproc()->nfault++;
+    if(myproc() && uvmfault(myproc(), rcr2(), tf->err & FEC_WR) == 0)
+      break;
+    // Anything else is a real fault.
+    // fall through
+
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
@@ -172,11 +203,12 @@ trap(struct trapframe *tf)
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
 
-  // Force process to give up CPU on clock tick.
+  // Charge the clock tick to the running process; schedtick()
+  // gives up the CPU once its time slice is used up.
   // If interrupts were on while locks held, would need to check nlock.
   if(myproc() && myproc()->state == RUNNING &&
      tf->trapno == T_IRQ0+IRQ_TIMER)
-    yield();
+    schedtick();
 
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
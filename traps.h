@@ -34,5 +34,6 @@
 #define IRQ_COM1         4
 #define IRQ_IDE         14
 #define IRQ_ERROR       19
+#define IRQ_RESCHED     24      // inter-processor reschedule interrupt
 #define IRQ_SPURIOUS    31
 
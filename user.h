@@ -1,5 +1,6 @@
 struct stat;
 struct rtcdate;
+struct rusage;
 
 // system calls
 int fork(void);
@@ -25,6 +26,18 @@ int sleep(int);
 int uptime(void);
 int date(struct rtcdate *);
 int alarm(int ticks, void (*handler)());
+int setpriority(int pid, int prio);
+int settickets(int n);
+int setsched(int policy);
+int getrusage(int who, struct rusage*);
+int freemem(void);
+int buddyinfo(uint*);
+int superpages(int);
+void* mmap(void*, uint, int, int, int, uint);
+int munmap(void*, uint);
+int shmget(int, uint);
+void* shmat(int);
+int shmdt(void*);
 
 // ulib.c
 int stat(const char*, struct stat*);
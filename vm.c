@@ -4,10 +4,20 @@
 #include "x86.h"
 #include "memlayout.h"
 #include "mmu.h"
+#include "spinlock.h"
 #include "proc.h"
 #include "elf.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "mman.h"
 
 extern char data[];  // defined by kernel.ld
+
+#define SPGORDER 10     // kallocblk() order of a superpage
+#if MAXORDER < SPGORDER
+#error "MAXORDER too small for superpages"
+#endif
 pde_t *kpgdir;  // for use in scheduler()
 
 // Set up CPU's kernel segment descriptors.
@@ -44,7 +54,7 @@ seginit(void)
  * 如果alloc=1, 那么就通过kalloc()分配一个physical page用作page-table page, 并把它的物理地址赋值给PDE,
  * 然后再用VA的中间10位去找到这个刚分配的page-table page上面的PTE
  */
-static pte_t *
+pte_t *
 walkpgdir(pde_t *pgdir, const void *va, int alloc)
 {
   pde_t *pde;
@@ -52,13 +62,14 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
 
   /*page directory entry, kmap数组是va的来源*/
   pde = &pgdir[PDX(va)]; /*uses the upper 10 bits of the virtual address to find the PDE's address*/
+  if(*pde & PTE_PS)
+    panic("walkpgdir: superpage");
   if(*pde & PTE_P){ /*如果if成立, */
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde)); /*PTE_ADDR extracts the PPN(即page-table page在内存中的物理基地址) from PDE, P2V() adds 0x80000000, since PTE holds physical address*/
   } else {
-    if(!alloc || (pgtab = (pte_t*)kalloc()) == 0) /*如果not exsits, alloc a page-table page*/
+    // A zeroed page, so all those PTE_P bits are zero.
+    if(!alloc || (pgtab = (pte_t*)kalloczero()) == 0) /*如果not exsits, alloc a page-table page*/
       return 0;
-    // Make sure all those PTE_P bits are zero.
-    memset(pgtab, 0, PGSIZE);
     // The permissions here are overly generous, but they can
     // be further restricted by the permissions in the page table
     // entries, if necessary.
@@ -72,6 +83,25 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   return &pgtab[PTX(va)]; /*获得VA对应的PTE的地址*/
 }
 
+// Make sure pgdir has a page table for user address va, so
+// that mappages() will not need to allocate one.  Unlike
+// walkpgdir(), swaps pages out to make room if memory has run
+// out, so may sleep.  Returns -1 if out of memory.
+static int
+ptalloc(pde_t *pgdir, uint va)
+{
+  pde_t *pde;
+  char *mem;
+
+  pde = &pgdir[PDX(va)];
+  if(*pde & PTE_P)
+    return 0;
+  if((mem = kallocswap(1)) == 0)
+    return -1;
+  *pde = V2P(mem) | PTE_P | PTE_W | PTE_U;
+  return 0;
+}
+
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned.
@@ -102,6 +132,53 @@ mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
   return 0;
 }
 
+// Map [va, va+size) to pa in the kernel part of pgdir, with
+// 4 MB superpages wherever va and pa are both aligned to one
+// and 4 KB pages elsewhere.
+static int
+mapkernel(pde_t *pgdir, uint va, uint size, uint pa, int perm)
+{
+  uint n;
+
+  while(size > 0){
+    if(va % SPGSIZE == 0 && pa % SPGSIZE == 0 && size >= SPGSIZE){
+      pgdir[PDX(va)] = pa | perm | PTE_PS | PTE_P;
+      n = SPGSIZE;
+    } else {
+      n = SPGSIZE - va % SPGSIZE;
+      if(n > size)
+        n = size;
+      if(mappages(pgdir, (void*)va, n, pa, perm) < 0)
+        return -1;
+    }
+    va += n;
+    pa += n;
+    size -= n;
+  }
+  return 0;
+}
+
+// Split the user superpage that maps va into a page table of
+// 4 KB pages mapping the same memory, for code that works on
+// single pages.  Returns -1 if out of memory.
+static int
+splitsuper(pde_t *pgdir, uint va)
+{
+  pde_t *pde;
+  pte_t *pgtab;
+  uint pa, flags, i;
+
+  pde = &pgdir[PDX(va)];
+  if((pgtab = (pte_t*)kalloc()) == 0)
+    return -1;
+  pa = PTE_ADDR(*pde);
+  flags = PTE_FLAGS(*pde) & ~PTE_PS;
+  for(i = 0; i < NPTENTRIES; i++)
+    pgtab[i] = (pa + i*PGSIZE) | flags;
+  *pde = V2P(pgtab) | PTE_P | PTE_W | PTE_U;
+  return 0;
+}
+
 // There is one page table per process, plus one that's used when
 // a CPU is not running any process (kpgdir). The kernel uses the
 // current process's page table during system calls and interrupts;
@@ -115,13 +192,14 @@ mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
 //   KERNBASE..KERNBASE+EXTMEM: mapped to 0..EXTMEM (for I/O space)
 //   KERNBASE+EXTMEM..data: mapped to EXTMEM..V2P(data)
 //                for the kernel's instructions and r/o data
-//   data..KERNBASE+PHYSTOP: mapped to V2P(data)..PHYSTOP,
+//   data..KERNBASE+phystop: mapped to V2P(data)..phystop,
 //                                  rw data + free physical memory
 //   0xfe000000..0: mapped direct (devices such as ioapic)
 //
 // The kernel allocates physical memory for its heap and for user memory
-// between V2P(end) and the end of physical memory (PHYSTOP)
-// (directly addressable from end..P2V(PHYSTOP)).
+// between V2P(end) and the end of physical memory (phystop, found
+// at boot from the BIOS memory map; see kalloc.c)
+// (directly addressable from end..P2V(phystop)).
 
 // This table defines the kernel's mappings, which are present in
 // every process's page table.
@@ -133,7 +211,7 @@ static struct kmap {
 } kmap[] = {
  { (void*)KERNBASE, 0,             EXTMEM,    PTE_W}, // I/O space
  { (void*)KERNLINK, V2P(KERNLINK), V2P(data), 0},     // kern text+rodata
- { (void*)data,     V2P(data),     PHYSTOP,   PTE_W}, // kern data+memory
+ { (void*)data,     V2P(data),     0,         PTE_W}, // kern data+memory, to phystop
  { (void*)DEVSPACE, DEVSPACE,      0,         PTE_W}, // more devices
 };
 
@@ -141,43 +219,52 @@ static struct kmap {
 /*
  * 在内核执行时候切换页表是可行的, 因为每个进程页表的内核部分的映射都是一样的
  * setupkvm() 只设置内核部分的页表内容, 不涉及到user memory的映射
+ *
+ * The kernel mappings never change after boot, so every page
+ * directory shares kpgdir's kernel page tables: setupkvm() only
+ * copies the kernel's page directory entries, and freevm() leaves
+ * the tables they point to alone.  May sleep to swap pages out.
  */
 pde_t*
 setupkvm(void)
 {
   pde_t *pgdir;
-  struct kmap *k;
   /*
    * 分配一个物理页保存Page Directory, 返回的是这个物理页的VA
    * 注意这里只创建了Page Directory, 还没有创建对应的Page-Table page
    */
-  if((pgdir = (pde_t*)kalloc()) == 0) 
+  if((pgdir = (pde_t*)kallocswap(1)) == 0) 
     return 0;
-  memset(pgdir, 0, PGSIZE);
-  if (P2V(PHYSTOP) > (void*)DEVSPACE)
-    panic("PHYSTOP too high");
-
-  /*
-   * 开始使用kmap里描述了内核的映射关系[VA <-> PA]来建立Page-Table page及其entry
-   * 注意: 是已知VA与PA的对应关系的前提下, 来建立PTE, 这样建立出的PTE自然就描述了该VA与PA的关系
-   */
-  for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
-    if(mappages(pgdir, k->virt, k->phys_end - k->phys_start,
-                (uint)k->phys_start, k->perm) < 0) { 
-      freevm(pgdir);
-      return 0;
-    }
+  memmove(&pgdir[PDX(KERNBASE)], &kpgdir[PDX(KERNBASE)],
+          (NPDENTRIES - PDX(KERNBASE)) * sizeof(pde_t));
   return pgdir;
 }
 
 // Allocate one page table for the machine for the kernel address
-// space for scheduler processes.
+// space for scheduler processes.  Its kernel page tables are the
+// ones every other page directory shares.
 /*在这之前我们使用的是entrypgdir中关于内核简单(加减KERNBASE)的映射*/
 void
 kvmalloc(void)
 {
-  kpgdir = setupkvm();
-  switchkvm();
+  struct kmap *k;
+
+  if((kpgdir = (pde_t*)kalloczero()) == 0)
+    panic("kvmalloc");
+  kmap[2].phys_end = phystop;
+
+  /*
+   * 开始使用kmap里描述了内核的映射关系[VA <-> PA]来建立Page-Table page及其entry
+   * 注意: 是已知VA与PA的对应关系的前提下, 来建立PTE, 这样建立出的PTE自然就描述了该VA与PA的关系
+   */
+  // The kernel mappings are the same in every address space,
+  // so mark them global: a %cr3 load leaves them in the TLB.
+  for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
+    if(mapkernel(kpgdir, (uint)k->virt, k->phys_end - k->phys_start,
+                 k->phys_start, k->perm | PTE_G) < 0)
+      panic("kvmalloc: out of memory");
+  // Not switchkvm(): there is no struct cpu for us yet.
+  lcr3(V2P(kpgdir));
 }
 
 // Switch h/w page table register to the kernel-only page table,
@@ -188,8 +275,11 @@ kvmalloc(void)
 void
 switchkvm(void)
 {
+  pushcli();
   /*在切换之前我们还是使用的entrypgdir中的映射, 所以虚拟地址减去KERNBASE就是物理地址*/
   lcr3(V2P(kpgdir));   // switch to the kernel page table
+  mycpu()->pgdir = kpgdir;
+  popcli();
 }
 
 // Switch TSS and h/w page table to correspond to process p.
@@ -243,6 +333,7 @@ switchuvm(struct proc *p)
 
   // 切换到目标进程的页目录，CR3寄存器存放的是页目录的物理地址
   lcr3(V2P(p->pgdir));  // switch to process's address space
+  mycpu()->pgdir = p->pgdir;
   popcli();
 }
 
@@ -263,9 +354,7 @@ inituvm(pde_t *pgdir, char *init, uint sz)
     panic("inituvm: more than a page");
 
   /* 分配一页(4KB)的物理内存，来保存init二进制文件 */
-  mem = kalloc(); 
-  
-  memset(mem, 0, PGSIZE); 
+  mem = kalloczero(); 
 
   /* 将init二进制文件所在的物理区域，映射到虚拟内存从0开始的空间 */
   mappages(pgdir, 0, PGSIZE, V2P(mem), PTE_W|PTE_U); 
@@ -274,33 +363,6 @@ inituvm(pde_t *pgdir, char *init, uint sz)
   memmove(mem, init, sz); 
 }
 
-// Load a program segment into pgdir.  addr must be page-aligned
-// and the pages from addr to addr+sz must already be mapped.
-/*
- * 
- */
-int
-loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
-{
-  uint i, pa, n;
-  pte_t *pte;
-
-  if((uint) addr % PGSIZE != 0)
-    panic("loaduvm: addr must be page aligned");
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, addr+i, 0)) == 0) /*find the physical address of the alocated memory at which to write each page of the ELF segment*/
-      panic("loaduvm: address should exist");
-    pa = PTE_ADDR(*pte);
-    if(sz - i < PGSIZE)
-      n = sz - i;
-    else
-      n = PGSIZE;
-    if(readi(ip, P2V(pa), offset+i, n) != n) /*read from the file*/
-      return -1;
-  }
-  return 0;
-}
-
 // Allocate page tables and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
 int
@@ -316,13 +378,11 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(oldsz);
   for(; a < newsz; a += PGSIZE){
-    mem = kalloc();
-    if(mem == 0){
+    if(ptalloc(pgdir, a) < 0 || (mem = kallocswap(1)) == 0){
       cprintf("allocuvm out of memory\n");
       deallocuvm(pgdir, newsz, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
 
     if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){ 
       cprintf("allocuvm out of memory (2)\n");
@@ -349,6 +409,18 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(newsz);
   for(; a  < oldsz; a += PGSIZE){
+    if(pgdir[PDX(a)] & PTE_PS){
+      // Free a superpage whole, or split it if only its
+      // upper part goes.
+      if(a % SPGSIZE == 0){
+        kfreeblk(P2V(PTE_ADDR(pgdir[PDX(a)])), SPGORDER);
+        pgdir[PDX(a)] = 0;
+        a += SPGSIZE - PGSIZE;
+        continue;
+      }
+      if(splitsuper(pgdir, a) < 0)
+        return 0;
+    }
     pte = walkpgdir(pgdir, (char*)a, 0);
     if(!pte)
       a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
@@ -359,22 +431,33 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
       char *v = P2V(pa);
       kfree(v);
       *pte = 0;
+    } else if(*pte & PTE_SWAP){
+      swapfree(PTE_SLOT(*pte));
+      *pte = 0;
     }
   }
   return newsz;
 }
 
 // Free a page table and all the physical memory pages
-// in the user part.
+// in the user part.  The kernel page tables are shared
+// (see setupkvm) and stay.
 void
 freevm(pde_t *pgdir)
 {
+  struct cpu *c;
   uint i;
 
   if(pgdir == 0)
     panic("freevm: no pgdir");
+  // A CPU that switched away from a process keeps its page
+  // directory loaded until the scheduler picks the next one
+  // (see scheduler); wait for it to move on.
+  for(c = cpus; c < cpus+ncpu; c++)
+    while(c->pgdir == pgdir)
+      ;
   deallocuvm(pgdir, KERNBASE, 0);
-  for(i = 0; i < NPDENTRIES; i++){
+  for(i = 0; i < PDX(KERNBASE); i++){
     if(pgdir[i] & PTE_P){
       char * v = P2V(PTE_ADDR(pgdir[i]));
       kfree(v);
@@ -396,37 +479,302 @@ clearpteu(pde_t *pgdir, char *uva)
   *pte &= ~PTE_U;
 }
 
-// Given a parent process's page table, create a copy
-// of it for a child.
-pde_t*
-copyuvm(pde_t *pgdir, uint sz)
+// Share the present pages of [start, end) in pgdir with d,
+// copy-on-write unless share is set.
+static int
+copyrange(pde_t *pgdir, pde_t *d, uint start, uint end, int share)
 {
-  pde_t *d;
-  pte_t *pte;
+  pte_t *pte, *dpte;
   uint pa, i, flags;
-  char *mem;
 
-  if((d = setupkvm()) == 0)
-    return 0;
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
+  for(i = start; i < end; i += PGSIZE){
+    // Superpages are shared copy-on-write a page at a time.
+    if((pgdir[PDX(i)] & PTE_PS) && splitsuper(pgdir, i) < 0)
+      return -1;
+    if((pgdir[PDX(i)] & PTE_P) && ptalloc(d, i) < 0)
+      return -1;
+    // Heap pages that have not been touched yet stay
+    // that way in the child (see uvmfault).
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    // A page in swap gets a second reference to its slot.
+    if(*pte & PTE_SWAP){
+      if((dpte = walkpgdir(d, (void*)i, 1)) == 0)
+        return -1;
+      *dpte = *pte;
+      swapdup(PTE_SLOT(*pte));
+      continue;
+    }
     if(!(*pte & PTE_P))
-      panic("copyuvm: page not present");
+      continue;
+    if((*pte & PTE_W) && !share)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
+    if(mappages(d, (void*)i, PGSIZE, pa, flags) < 0)
+      return -1;
+    kincref(P2V(pa));
+  }
+  return 0;
+}
+
+// Given a parent process, create a copy of its page table
+// for a child, covering its memory below p->sz and its mmap()
+// regions.  The user pages themselves are shared
+// copy-on-write: writable pages become read-only and PTE_COW
+// in both page tables, and cowfault() copies a page on the
+// first write to it.  p must be the current process.
+pde_t*
+copyuvm(struct proc *p)
+{
+  pde_t *d;
+  struct vma *v;
+  int pin;
+
+  // Keep swapout() away from p's pages until the child holds
+  // its references to them: copyrange() may sleep or be
+  // preempted between reading a PTE and kincref().
+  pin = p->upin;
+  p->upin = 1;
+  if((d = setupkvm()) == 0)
+    goto bad;
+  if(copyrange(p->pgdir, d, 0, p->sz, 0) < 0)
+    goto bad;
+  for(v = p->vmas; v < &p->vmas[NVMA]; v++)
+    if(v->end && copyrange(p->pgdir, d, v->start, v->end, v->shm != 0) < 0)
       goto bad;
-    memmove(mem, (char*)P2V(pa), PGSIZE);
-    if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0) {
+  // Flush the parent's TLB entries that still allow writes.
+  lcr3(V2P(p->pgdir));
+  p->upin = pin;
+  return d;
+
+bad:
+  if(d)
+    freevm(d);
+  lcr3(V2P(p->pgdir));
+  p->upin = pin;
+  return 0;
+}
+
+// Handle a write fault at user address va in pgdir.  If va is
+// on a copy-on-write page, give pgdir its own writable copy, or
+// just make the page writable again if nothing else shares it.
+// Returns -1 if va is not copy-on-write or memory runs out.
+int
+cowfault(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  uint pa, flags;
+  char *mem;
+
+  if(va >= KERNBASE || (pte = walkpgdir(pgdir, (char*)va, 0)) == 0)
+    return -1;
+  if((*pte & (PTE_P|PTE_U|PTE_COW)) != (PTE_P|PTE_U|PTE_COW))
+    return -1;
+  pa = PTE_ADDR(*pte);
+  flags = (PTE_FLAGS(*pte) | PTE_W) & ~PTE_COW;
+  if(krefcount(P2V(pa)) > 1){
+    if((mem = kallocswap(0)) == 0)
+      return -1;
+    memmove(mem, P2V(pa), PGSIZE);
+    *pte = V2P(mem) | flags;
+    kfree(P2V(pa));
+  } else
+    *pte = pa | flags;
+  lcr3(V2P(pgdir));
+  return 0;
+}
+
+// Return a page holding the page at va of segment s, read in
+// from p's executable.  Pages of read-only segments come from
+// the executable's page cache and are shared with every other
+// process running it.  Returns 0 if out of memory or the
+// executable cannot be read.
+static char*
+segpage(struct proc *p, struct seg *s, uint va)
+{
+  uint off, n;
+  char *mem;
+
+  off = va - s->va;
+  n = 0;
+  if(off < s->filesz)
+    n = s->filesz - off < PGSIZE ? s->filesz - off : PGSIZE;
+  ilock(p->exe);
+  if(SHARETEXT && s->perm == 0)
+    mem = pcget(p->exe, s->off + off, n);
+  else if((mem = kallocswap(1)) != 0){
+    if(n > 0 && readi(p->exe, mem, s->off + off, n) != n){
       kfree(mem);
-      goto bad;
+      mem = 0;
     }
   }
-  return d;
+  iunlock(p->exe);
+  return mem;
+}
 
-bad:
-  freevm(d);
+// Back the 4 MB-aligned region holding va with a zeroed
+// superpage, if p has asked for superpages and the whole
+// region is untouched heap: below p->sz, outside the program
+// segments, and without a page table.  Returns -1 if not.
+static int
+mapsuper(struct proc *p, uint va)
+{
+  struct seg *s;
+  uint a;
+  char *mem;
+
+  a = va - va % SPGSIZE;
+  if(a + SPGSIZE > p->sz || (p->pgdir[PDX(a)] & PTE_P))
+    return -1;
+  for(s = p->segs; s < &p->segs[p->nseg]; s++)
+    if(s->va < a + SPGSIZE && a < s->va + s->memsz)
+      return -1;
+  if((mem = kallocblk(SPGORDER)) == 0)
+    return -1;
+  memset(mem, 0, SPGSIZE);
+  p->pgdir[PDX(a)] = V2P(mem) | PTE_PS | PTE_P | PTE_W | PTE_U;
+  return 0;
+}
+
+// Return a page for va in mapping v: a zeroed page, the
+// segment's page for a shared segment, or the file's page from
+// its page cache, shared with everyone else mapping or running
+// that part of the file.  Returns 0 if out
+// of memory or the file cannot be read.
+static char*
+vmapage(struct vma *v, uint va)
+{
+  struct inode *ip;
+  uint off, n;
+  char *mem;
+
+  if(v->shm)
+    return shmpage(v->shm, v->off + (va - v->start));
+  if(v->f == 0)
+    return kallocswap(1);
+  ip = v->f->ip;
+  off = v->off + (va - v->start);
+  ilock(ip);
+  n = 0;
+  if(off < ip->size)
+    n = ip->size - off < PGSIZE ? ip->size - off : PGSIZE;
+  mem = pcget(ip, off, n);
+  iunlock(ip);
+  return mem;
+}
+
+// Handle a page fault at user address va in process p.  A page
+// below p->sz that is not present is either part of the program,
+// which exec() left to be read in from the executable on first
+// touch, or heap that sbrk() handed out lazily: map a zeroed page
+// there, or a whole superpage if the process asked for them.
+// Above p->sz, a page of an mmap() region is mapped the same way.
+// A write to a read-only page may be copy-on-write.
+// Returns -1 if va is not a valid user address, the executable
+// cannot be read, or memory runs out.  May sleep.
+static int
+pagefault(struct proc *p, uint va, int write)
+{
+  pte_t *pte;
+  struct seg *s;
+  struct vma *v;
+  uint perm;
+  char *mem;
+
+  v = 0;
+  if(va >= p->sz && (v = vmalookup(p, va)) == 0)
+    return -1;
+  va = PGROUNDDOWN(va);
+  // Superpages are always present and writable.
+  if(p->pgdir[PDX(va)] & PTE_PS)
+    return 0;
+  pte = walkpgdir(p->pgdir, (char*)va, 0);
+  if(pte == 0 && p->superpages && mapsuper(p, va) == 0)
+    return 0;
+  if(pte && (*pte & PTE_SWAP) && swapin(p->pgdir, va) < 0)
+    return -1;
+  if(pte == 0 || (*pte & PTE_P) == 0){
+    if(ptalloc(p->pgdir, va) < 0)
+      return -1;
+    for(s = p->segs; s < &p->segs[p->nseg]; s++)
+      if(va >= s->va && va < s->va + s->memsz)
+        break;
+    if(v){
+      if(write && (v->prot & PROT_WRITE) == 0)
+        return -1;
+      mem = vmapage(v, va);
+      perm = (v->prot & PROT_WRITE) ? PTE_W : 0;
+    } else if(s < &p->segs[p->nseg]){
+      if(write && s->perm == 0)
+        return -1;
+      mem = segpage(p, s, va);
+      perm = s->perm;
+    } else {
+      mem = kallocswap(1);
+      perm = PTE_W;
+    }
+    if(mem == 0)
+      return -1;
+    // Just used, as far as the swap clock is concerned.
+    if(mappages(p->pgdir, (char*)va, PGSIZE, V2P(mem), perm|PTE_U|PTE_A) < 0){
+      kfree(mem);
+      return -1;
+    }
+    return 0;
+  }
+  if((*pte & PTE_U) == 0)
+    return -1;
+  if(write && (*pte & PTE_W) == 0)
+    return cowfault(p->pgdir, va);
+  return 0;
+}
+
+// Handle a page fault in p, the current process, with p's pages
+// kept where they are: cowfault() and the rest read a PTE, may
+// sleep in kallocswap(), and then rely on what they read.
+int
+uvmfault(struct proc *p, uint va, int write)
+{
+  int pin, r;
+
+  pin = p->upin;
+  p->upin = 1;
+  r = pagefault(p, va, write);
+  p->upin = pin;
+  return r;
+}
+
+// Fault in the user pages of p covering [va, va+len) now,
+// writable if write is set, so that a system call can use them
+// without taking a page fault it could not recover from, or
+// one that sleeps while it holds a spinlock.  The range must
+// lie within one part of p's memory (see userend).  p's pages
+// are not swapped out until the system call returns.
+int
+uvmprefault(struct proc *p, uint va, uint len, int write)
+{
+  pte_t *pte;
+  uint a, last;
+
+  if(len == 0)
+    return 0;
+  p->upin = 1;
+  a = PGROUNDDOWN(va);
+  last = PGROUNDDOWN(va + len - 1);
+  for(;;){
+    if((p->pgdir[PDX(a)] & PTE_PS) == 0){
+      pte = walkpgdir(p->pgdir, (char*)a, 0);
+      if(pte == 0 || (*pte & PTE_P) == 0 || (write && (*pte & PTE_W) == 0))
+        if(uvmfault(p, a, write) < 0)
+          return -1;
+    }
+    if(a == last)
+      break;
+    a += PGSIZE;
+  }
   return 0;
 }
 
@@ -437,6 +785,11 @@ uva2ka(pde_t *pgdir, char *uva)
 {
   pte_t *pte;
 
+  if(pgdir[PDX(uva)] & PTE_PS){
+    if((pgdir[PDX(uva)] & PTE_U) == 0)
+      return 0;
+    return (char*)P2V(PTE_ADDR(pgdir[PDX(uva)])) + (uint)uva % SPGSIZE;
+  }
   pte = walkpgdir(pgdir, uva, 0);
   if((*pte & PTE_P) == 0)
     return 0;
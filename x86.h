@@ -117,6 +117,16 @@ sti(void)
   asm volatile("sti");
 }
 
+// Enable interrupts and halt until the next one arrives.
+// sti takes effect only after the following instruction, so an
+// interrupt that is already pending wakes the hlt instead of
+// being taken just before it.
+static inline void
+stihlt(void)
+{
+  asm volatile("sti; hlt" : : : "memory");
+}
+
 static inline uint
 xchg(volatile uint *addr, uint newval)
 {
@@ -130,6 +140,15 @@ xchg(volatile uint *addr, uint newval)
   return result;
 }
 
+static inline uint64
+rdtsc(void)
+{
+  uint lo, hi;
+
+  asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64)hi << 32) | lo;
+}
+
 static inline uint
 rcr2(void)
 {
@@ -0,0 +1,92 @@
+// Zeroed page benchmark.
+// Time page faults on fresh heap pages, fork+exit and
+// fork+exec+exit, which all need zeroed pages (heap pages,
+// page tables, page directories).  Each round asks for fewer
+// pages than the kernel keeps pre-zeroed and then sleeps, so
+// idle CPUs can refill the pool.  A round is far shorter than
+// a clock tick, so it is timed with the TSC; compare the
+// cycle counts with a kernel built with make NZERO=0.
+//
+// usage: zerobench [rounds]
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define PGSIZE 4096
+#define NPAGES 128
+#define NFORK  8
+
+static inline uint64
+rdtsc(void)
+{
+  uint lo, hi;
+
+  asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64)hi << 32) | lo;
+}
+
+char *execargs[] = { "zerobench", "exit", 0 };
+
+int
+main(int argc, char *argv[])
+{
+  char *p, *heap;
+  uint faultc, forkc, execc;
+  uint64 t0;
+  int rounds, r, i;
+
+  // What the exec case runs.
+  if(argc > 1 && strcmp(argv[1], "exit") == 0)
+    exit();
+
+  rounds = 50;
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  if(rounds < 1){
+    printf(2, "zerobench: rounds must be at least 1\n");
+    exit();
+  }
+
+  faultc = forkc = execc = 0;
+  for(r = 0; r < rounds; r++){
+    sleep(5);
+    if((heap = sbrk(NPAGES*PGSIZE)) == (char*)-1){
+      printf(2, "zerobench: sbrk failed\n");
+      exit();
+    }
+    t0 = rdtsc();
+    for(p = heap; p < heap + NPAGES*PGSIZE; p += PGSIZE)
+      if(*p != 0){
+        printf(2, "zerobench: page not zeroed\n");
+        exit();
+      }
+    faultc += (uint)(rdtsc() - t0) / NPAGES;
+    sbrk(-NPAGES*PGSIZE);
+
+    sleep(5);
+    t0 = rdtsc();
+    for(i = 0; i < NFORK; i++){
+      if(fork() == 0)
+        exit();
+      wait();
+    }
+    forkc += (uint)(rdtsc() - t0) / NFORK;
+
+    sleep(5);
+    t0 = rdtsc();
+    for(i = 0; i < NFORK; i++){
+      if(fork() == 0){
+        exec(execargs[0], execargs);
+        printf(2, "zerobench: exec failed\n");
+        exit();
+      }
+      wait();
+    }
+    execc += (uint)(rdtsc() - t0) / NFORK;
+  }
+  printf(1, "page fault: %d cycles\n", faultc / rounds);
+  printf(1, "fork+exit: %d cycles\n", forkc / rounds);
+  printf(1, "fork+exec+exit: %d cycles\n", execc / rounds);
+  exit();
+}